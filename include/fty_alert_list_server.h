@@ -32,6 +32,10 @@ extern "C" {
     FTY_ALERT_LIST_EXPORT void
     fty_alert_list_server_stream(zsock_t *pipe, void *args);
 
+    //  set state file of the cache, before init_alert ()
+    FTY_ALERT_LIST_EXPORT void
+    set_state_file(const char *path, const char *filename);
+
     FTY_ALERT_LIST_EXPORT void
     init_alert(bool verb);
 
@@ -137,8 +137,11 @@ find %{buildroot} -name '*.la' | xargs rm -f
 %{_mandir}/man1/generate_alert*
 %{_bindir}/fty-alert-list-convert
 %{_mandir}/man1/fty-alert-list-convert*
+%{_bindir}/fty-alert-list-inspect
+%{_mandir}/man1/fty-alert-list-inspect*
 %{SYSTEMD_UNIT_DIR}/fty-alert-list.service
 %dir %{_sysconfdir}/fty-alert-list
+%config(noreplace) %{_sysconfdir}/fty-alert-list/fty-alert-list.cfg
 %if 0%{?suse_version} > 1315
 %post
 %systemd_post fty-alert-list.service
@@ -0,0 +1,575 @@
+/*  =========================================================================
+    alert_frame - Scanner of encoded fty_proto ALERT messages
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/*
+@header
+    alert_frame - Scanner of encoded fty_proto ALERT messages
+@discuss
+    fty_proto_decode () copies every field of an alert, including the aux
+    hash, the description and the action list. Most alerts coming from
+    _ALERTS_SYS only refresh an alert we already have, so the stream actor
+    first scans the frame in place and decodes it only when needed.
+
+    The scanner follows the zproto wire format of the ALERT message:
+
+        signature   number 2
+        id          number 1
+        aux         hash
+        time        number 8
+        ttl         number 4
+        rule        string
+        name        string
+        state       string
+        severity    string
+        description longstr
+        metadata    longstr
+        action      strings
+
+    alert_frame_probe () encodes a known alert with the fty_proto codec and
+    scans it back. If the codec ever disagrees with the layout above, the
+    scanner stays disabled and callers fall back to fty_proto_decode ().
+@end
+*/
+
+#include <atomic>
+#include <string>
+#include "fty_alert_list_classes.h"
+
+// learnt by alert_frame_probe (), 0 while the scanner is disabled
+static std::atomic<uint16_t> s_signature (0);
+static std::atomic<int> s_alert_id (-1);
+
+#define SCAN_CHECK(bytes) { \
+    if ((size_t) (ceiling - needle) < (size_t) (bytes)) \
+        return -1; \
+}
+
+#define SCAN_NUMBER1(host) { \
+    SCAN_CHECK (1); \
+    (host) = needle [0]; \
+    needle += 1; \
+}
+
+#define SCAN_NUMBER2(host) { \
+    SCAN_CHECK (2); \
+    (host) = ((uint16_t) (needle [0]) << 8) \
+           +  (uint16_t) (needle [1]); \
+    needle += 2; \
+}
+
+#define SCAN_NUMBER4(host) { \
+    SCAN_CHECK (4); \
+    (host) = ((uint32_t) (needle [0]) << 24) \
+           + ((uint32_t) (needle [1]) << 16) \
+           + ((uint32_t) (needle [2]) << 8) \
+           +  (uint32_t) (needle [3]); \
+    needle += 4; \
+}
+
+#define SCAN_NUMBER8(host) { \
+    SCAN_CHECK (8); \
+    (host) = ((uint64_t) (needle [0]) << 56) \
+           + ((uint64_t) (needle [1]) << 48) \
+           + ((uint64_t) (needle [2]) << 40) \
+           + ((uint64_t) (needle [3]) << 32) \
+           + ((uint64_t) (needle [4]) << 24) \
+           + ((uint64_t) (needle [5]) << 16) \
+           + ((uint64_t) (needle [6]) << 8) \
+           +  (uint64_t) (needle [7]); \
+    needle += 8; \
+}
+
+#define SCAN_STRING(span) { \
+    size_t string_size; \
+    SCAN_NUMBER1 (string_size); \
+    SCAN_CHECK (string_size); \
+    (span).data = (const char *) needle; \
+    (span).size = string_size; \
+    needle += string_size; \
+}
+
+#define SCAN_LONGSTR(span) { \
+    size_t string_size; \
+    SCAN_NUMBER4 (string_size); \
+    SCAN_CHECK (string_size); \
+    (span).data = (const char *) needle; \
+    (span).size = string_size; \
+    needle += string_size; \
+}
+
+int
+alert_frame_scan_buffer (alert_frame_t *self, const byte *data, size_t size)
+{
+    assert (self);
+    if (!data || s_signature == 0)
+        return -1;
+
+    const byte *needle = data;
+    const byte *ceiling = data + size;
+    self->encoded.data = (const char *) data;
+    self->encoded.size = size;
+
+    uint16_t signature;
+    SCAN_NUMBER2 (signature);
+    if (signature != s_signature)
+        return -1;
+    int id;
+    SCAN_NUMBER1 (id);
+    if (id != s_alert_id)
+        return -1;
+
+    // aux: count, then key string and value longstr pairs
+    const byte *start = needle;
+    uint32_t count;
+    SCAN_NUMBER4 (count);
+    while (count--) {
+        alert_span_t key, value;
+        SCAN_STRING (key);
+        SCAN_LONGSTR (value);
+        (void) key; (void) value;
+    }
+    self->aux.data = (const char *) start;
+    self->aux.size = needle - start;
+
+    SCAN_NUMBER8 (self->time);
+    SCAN_NUMBER4 (self->ttl);
+    SCAN_STRING (self->rule);
+    SCAN_STRING (self->name);
+    SCAN_STRING (self->state);
+    SCAN_STRING (self->severity);
+    SCAN_LONGSTR (self->description);
+    SCAN_LONGSTR (self->metadata);
+
+    // action: count, then longstr items
+    start = needle;
+    SCAN_NUMBER4 (count);
+    while (count--) {
+        alert_span_t item;
+        SCAN_LONGSTR (item);
+        (void) item;
+    }
+    self->action.data = (const char *) start;
+    self->action.size = needle - start;
+
+    // the whole frame must be consumed
+    return needle == ceiling ? 0 : -1;
+}
+
+int
+alert_frame_scan (alert_frame_t *self, zmsg_t *msg)
+{
+    assert (self);
+    if (!msg)
+        return -1;
+    zframe_t *frame = zmsg_first (msg);
+    if (!frame)
+        return -1;
+    return alert_frame_scan_buffer (self, zframe_data (frame), zframe_size (frame));
+}
+
+bool
+alert_frame_action_next (const alert_frame_t *self, size_t *cursor, alert_span_t *action)
+{
+    assert (self);
+    assert (cursor);
+    assert (action);
+
+    // bounds were checked by the scan, first 4 bytes are the count
+    size_t offset = *cursor ? *cursor : 4;
+    if (offset + 4 > self->action.size)
+        return false;
+    const byte *needle = (const byte *) self->action.data + offset;
+    action->size = ((size_t) needle [0] << 24) + ((size_t) needle [1] << 16)
+                 + ((size_t) needle [2] << 8)  +  (size_t) needle [3];
+    action->data = (const char *) needle + 4;
+    *cursor = offset + 4 + action->size;
+    return true;
+}
+
+// read 4-byte number at 'data'
+static size_t
+s_number4 (const char *data)
+{
+    const byte *needle = (const byte *) data;
+    return ((size_t) needle [0] << 24) + ((size_t) needle [1] << 16)
+         + ((size_t) needle [2] << 8)  +  (size_t) needle [3];
+}
+
+// write 4-byte number 'host' at 'needle', returns end of the number
+static byte *
+s_put_number4 (byte *needle, size_t host)
+{
+    needle [0] = (byte) ((host >> 24) & 255);
+    needle [1] = (byte) ((host >> 16) & 255);
+    needle [2] = (byte) ((host >> 8)  & 255);
+    needle [3] = (byte) ((host)       & 255);
+    return needle + 4;
+}
+
+bool
+alert_frame_aux_next (const alert_frame_t *self, size_t *cursor, alert_span_t *key, alert_span_t *value)
+{
+    assert (self);
+    assert (cursor);
+    assert (key);
+    assert (value);
+
+    // bounds were checked by the scan, first 4 bytes are the count
+    size_t offset = *cursor ? *cursor : 4;
+    if (offset + 1 > self->aux.size)
+        return false;
+    key->size = (byte) self->aux.data [offset];
+    key->data = self->aux.data + offset + 1;
+    offset += 1 + key->size;
+    value->size = s_number4 (self->aux.data + offset);
+    value->data = self->aux.data + offset + 4;
+    *cursor = offset + 4 + value->size;
+    return true;
+}
+
+bool
+alert_frame_aux_find (const alert_frame_t *self, const char *key, alert_span_t *value)
+{
+    assert (self);
+    assert (key);
+    assert (value);
+
+    size_t cursor = 0;
+    alert_span_t item;
+    while (alert_frame_aux_next (self, &cursor, &item, value)) {
+        if (alert_span_streq (item, key))
+            return true;
+    }
+    return false;
+}
+
+fty_proto_t *
+alert_frame_decode (const alert_frame_t *self)
+{
+    assert (self);
+    fty_proto_t *alert = fty_proto_new (FTY_PROTO_ALERT);
+    if (!alert)
+        return NULL;
+
+    zhash_t *aux = zhash_new ();
+    zhash_autofree (aux);
+    size_t cursor = 0;
+    alert_span_t key, value;
+    while (alert_frame_aux_next (self, &cursor, &key, &value)) {
+        char name [256];
+        std::string string (value.data, value.size);
+        zhash_insert (aux, alert_span_copy (key, name, sizeof (name)), (void *) string.c_str ());
+    }
+    fty_proto_set_aux (alert, &aux);
+
+    fty_proto_set_time (alert, self->time);
+    fty_proto_set_ttl (alert, self->ttl);
+    fty_proto_set_rule (alert, "%.*s", (int) self->rule.size, self->rule.data);
+    fty_proto_set_name (alert, "%.*s", (int) self->name.size, self->name.data);
+    fty_proto_set_state (alert, "%.*s", (int) self->state.size, self->state.data);
+    fty_proto_set_severity (alert, "%.*s", (int) self->severity.size, self->severity.data);
+    fty_proto_set_description (alert, "%.*s", (int) self->description.size, self->description.data);
+    fty_proto_set_metadata (alert, "%.*s", (int) self->metadata.size, self->metadata.data);
+
+    zlist_t *actions = zlist_new ();
+    zlist_autofree (actions);
+    cursor = 0;
+    alert_span_t action;
+    while (alert_frame_action_next (self, &cursor, &action)) {
+        std::string string (action.data, action.size);
+        zlist_append (actions, (void *) string.c_str ());
+    }
+    fty_proto_set_action (alert, &actions);
+    return alert;
+}
+
+zmsg_t *
+alert_frame_encode_aux (const alert_frame_t *self, const char *key, const char *value)
+{
+    assert (self);
+    assert (key);
+    assert (value);
+    size_t key_size = strlen (key);
+    size_t value_size = strlen (value);
+    if (key_size > 255)
+        return NULL;
+
+    // signature and id, then aux, then the rest of the frame untouched
+    const char *header = self->encoded.data;
+    size_t header_size = self->aux.data - header;
+    const char *rest = self->aux.data + self->aux.size;
+    size_t rest_size = self->encoded.data + self->encoded.size - rest;
+
+    // existing item 'key' is dropped and encoded anew
+    size_t count = s_number4 (self->aux.data);
+    size_t items_size = self->aux.size - 4;
+    alert_span_t old;
+    bool found = alert_frame_aux_find (self, key, &old);
+    if (found) {
+        count--;
+        items_size -= 1 + key_size + 4 + old.size;
+    }
+
+    size_t size = header_size + 4 + items_size + 1 + key_size + 4 + value_size + rest_size;
+    zframe_t *frame = zframe_new (NULL, size);
+    if (!frame)
+        return NULL;
+    byte *needle = zframe_data (frame);
+
+    memcpy (needle, header, header_size);
+    needle += header_size;
+    needle = s_put_number4 (needle, count + 1);
+    size_t cursor = 0;
+    alert_span_t item_key, item_value;
+    while (alert_frame_aux_next (self, &cursor, &item_key, &item_value)) {
+        if (found && alert_span_streq (item_key, key))
+            continue;
+        // key string and value longstr are contiguous in the scanned frame
+        size_t item_size = 1 + item_key.size + 4 + item_value.size;
+        memcpy (needle, item_key.data - 1, item_size);
+        needle += item_size;
+    }
+    *needle++ = (byte) key_size;
+    memcpy (needle, key, key_size);
+    needle += key_size;
+    needle = s_put_number4 (needle, value_size);
+    memcpy (needle, value, value_size);
+    needle += value_size;
+    memcpy (needle, rest, rest_size);
+    needle += rest_size;
+    assert (needle == zframe_data (frame) + size);
+
+    zmsg_t *msg = zmsg_new ();
+    zmsg_append (msg, &frame);
+    return msg;
+}
+
+bool
+alert_span_streq (alert_span_t span, const char *string)
+{
+    if (!string)
+        return false;
+    return strlen (string) == span.size && memcmp (span.data, string, span.size) == 0;
+}
+
+char *
+alert_span_copy (alert_span_t span, char *buffer, size_t size)
+{
+    assert (buffer);
+    assert (size > 0);
+    size_t length = span.size < size - 1 ? span.size : size - 1;
+    memcpy (buffer, span.data, length);
+    buffer [length] = 0;
+    return buffer;
+}
+
+// encode an alert exercising every field
+static zmsg_t *
+s_probe_message (void)
+{
+    zlist_t *actions = zlist_new ();
+    zlist_autofree (actions);
+    zlist_append (actions, (void *) ACTION_EMAIL);
+    zlist_append (actions, (void *) ACTION_SMS);
+    fty_proto_t *alert = alert_new ("probe.rule@ups-1", "ups-1", "ACTIVE", "CRITICAL",
+        "probe description", 1234567890123ULL, &actions, 0);
+    if (!alert)
+        return NULL;
+    fty_proto_set_ttl (alert, 654321);
+    fty_proto_set_metadata (alert, "%s", "probe metadata");
+    fty_proto_aux_insert (alert, "ctime", "%s", "42");
+    return fty_proto_encode (&alert);
+}
+
+bool
+alert_frame_probe (void)
+{
+    zmsg_t *msg = s_probe_message ();
+    zframe_t *frame = msg ? zmsg_first (msg) : NULL;
+    if (!frame || zframe_size (frame) < 3) {
+        zmsg_destroy (&msg);
+        return false;
+    }
+    const byte *data = zframe_data (frame);
+    uint16_t signature = ((uint16_t) data [0] << 8) + data [1];
+    int id = data [2];
+
+    // scan with the learnt signature, keep it only if every field matches
+    s_alert_id = id;
+    s_signature = signature;
+    alert_frame_t scanned;
+    size_t cursor = 0;
+    alert_span_t action1, action2, dummy;
+    bool ok = signature != 0
+        && alert_frame_scan (&scanned, msg) == 0
+        && scanned.time == 1234567890123ULL
+        && scanned.ttl == 654321
+        && alert_span_streq (scanned.rule, "probe.rule@ups-1")
+        && alert_span_streq (scanned.name, "ups-1")
+        && alert_span_streq (scanned.state, "ACTIVE")
+        && alert_span_streq (scanned.severity, "CRITICAL")
+        && alert_span_streq (scanned.description, "probe description")
+        && alert_span_streq (scanned.metadata, "probe metadata")
+        && alert_frame_action_next (&scanned, &cursor, &action1)
+        && alert_frame_action_next (&scanned, &cursor, &action2)
+        && !alert_frame_action_next (&scanned, &cursor, &dummy)
+        && alert_span_streq (action1, ACTION_EMAIL)
+        && alert_span_streq (action2, ACTION_SMS);
+    if (!ok) {
+        s_signature = 0;
+        log_warning ("alert_frame: scanner doesn't match fty_proto codec, disabled");
+    }
+    zmsg_destroy (&msg);
+    return ok;
+}
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+alert_frame_test (bool verbose)
+{
+    printf (" * alert_frame: ");
+
+    //  @selftest
+    assert (alert_frame_probe ());
+
+    zlist_t *actions = zlist_new ();
+    zlist_autofree (actions);
+    zlist_append (actions, (void *) ACTION_SMS);
+    fty_proto_t *alert = alert_new ("Threshold", "ŽlUťOUčKý kůň", "RESOLVED", "WARNING",
+        "", 42, &actions, 0);
+    assert (alert);
+    zmsg_t *msg = fty_proto_encode (&alert);
+    assert (msg);
+
+    alert_frame_t frame;
+    assert (alert_frame_scan (&frame, msg) == 0);
+    assert (frame.time == 42);
+    assert (frame.ttl == 0);
+    assert (alert_span_streq (frame.rule, "Threshold"));
+    assert (alert_span_streq (frame.name, "ŽlUťOUčKý kůň"));
+    assert (!alert_span_streq (frame.name, "ŽlUťOUčKý"));
+    assert (!alert_span_streq (frame.name, NULL));
+    assert (alert_span_streq (frame.state, "RESOLVED"));
+    assert (alert_span_streq (frame.severity, "WARNING"));
+    assert (alert_span_streq (frame.description, ""));
+    // alert_new () keeps TTL in aux
+    assert (frame.aux.size > 4);
+
+    size_t cursor = 0;
+    alert_span_t action;
+    assert (alert_frame_action_next (&frame, &cursor, &action));
+    assert (alert_span_streq (action, ACTION_SMS));
+    assert (!alert_frame_action_next (&frame, &cursor, &action));
+
+    char buffer [256];
+    assert (streq (alert_span_copy (frame.state, buffer, sizeof (buffer)), "RESOLVED"));
+    assert (streq (alert_span_copy (frame.state, buffer, 4), "RES"));
+
+    // the scan agrees with the decoder
+    zmsg_t *copy = zmsg_dup (msg);
+    fty_proto_t *decoded = fty_proto_decode (&copy);
+    assert (decoded);
+    assert (frame.time == fty_proto_time (decoded));
+    assert (alert_span_streq (frame.rule, fty_proto_rule (decoded)));
+    assert (alert_span_streq (frame.name, fty_proto_name (decoded)));
+    fty_proto_destroy (&decoded);
+
+    // truncated or extended frames are rejected
+    zframe_t *original = zmsg_first (msg);
+    for (size_t size = 0; size < zframe_size (original); size++)
+        assert (alert_frame_scan_buffer (&frame, zframe_data (original), size) == -1);
+    byte *longer = (byte *) zmalloc (zframe_size (original) + 1);
+    memcpy (longer, zframe_data (original), zframe_size (original));
+    assert (alert_frame_scan_buffer (&frame, longer, zframe_size (original) + 1) == -1);
+    // different message id
+    longer [2] ^= 0xff;
+    assert (alert_frame_scan_buffer (&frame, longer, zframe_size (original)) == -1);
+    free (longer);
+    assert (alert_frame_scan_buffer (&frame, NULL, 0) == -1);
+    assert (alert_frame_scan (&frame, NULL) == -1);
+
+    zmsg_destroy (&msg);
+
+    // decode and aux splicing agree with the codec
+    {
+        zlist_t *actions = zlist_new ();
+        zlist_autofree (actions);
+        zlist_append (actions, (void *) ACTION_EMAIL);
+        zlist_append (actions, (void *) ACTION_SMS);
+        fty_proto_t *alert = alert_new ("Threshold", "ups-1", "ACTIVE", "CRITICAL",
+            "too hot", 42, &actions, 0);
+        fty_proto_set_ttl (alert, 300);
+        fty_proto_set_metadata (alert, "%s", "{\"x\": 1}");
+        fty_proto_aux_insert (alert, "ctime", "%s", "12");
+        fty_proto_t *expected = fty_proto_dup (alert);
+        zmsg_t *msg = fty_proto_encode (&alert);
+        assert (alert_frame_scan (&frame, msg) == 0);
+
+        alert_span_t value;
+        assert (alert_frame_aux_find (&frame, "ctime", &value));
+        assert (alert_span_streq (value, "12"));
+        assert (alert_frame_aux_find (&frame, "TTL", &value));
+        assert (!alert_frame_aux_find (&frame, "nothing", &value));
+
+        fty_proto_t *decoded = alert_frame_decode (&frame);
+        assert (decoded);
+        assert (alert_comparator (decoded, expected) == 0);
+        assert (fty_proto_ttl (decoded) == 300);
+        assert (streq (fty_proto_metadata (decoded), "{\"x\": 1}"));
+        assert (streq (fty_proto_aux_string (decoded, "ctime", ""), "12"));
+        assert (fty_proto_action_size (decoded) == 2);
+        fty_proto_destroy (&decoded);
+
+        // replace an item
+        zmsg_t *spliced = alert_frame_encode_aux (&frame, "ctime", "123456");
+        assert (spliced);
+        decoded = fty_proto_decode (&spliced);
+        assert (decoded);
+        assert (alert_comparator (decoded, expected) == 0);
+        assert (streq (fty_proto_aux_string (decoded, "ctime", ""), "123456"));
+        assert (streq (fty_proto_aux_string (decoded, "TTL", ""), "0"));
+        assert (zhash_size (fty_proto_aux (decoded)) == 2);
+        fty_proto_destroy (&decoded);
+
+        // add an item
+        spliced = alert_frame_encode_aux (&frame, "new", "");
+        assert (spliced);
+        alert_frame_t again;
+        assert (alert_frame_scan (&again, spliced) == 0);
+        assert (alert_frame_aux_find (&again, "new", &value));
+        assert (value.size == 0);
+        assert (alert_frame_aux_find (&again, "ctime", &value));
+        assert (alert_span_streq (value, "12"));
+        assert (alert_span_streq (again.description, "too hot"));
+        zmsg_destroy (&spliced);
+
+        fty_proto_destroy (&expected);
+        zmsg_destroy (&msg);
+    }
+
+    if (verbose)
+        log_debug ("alert_frame: scanner matches fty_proto codec");
+    //  @end
+
+    printf ("OK\n");
+}
@@ -0,0 +1,113 @@
+/*  =========================================================================
+    alert_frame - Scanner of encoded fty_proto ALERT messages
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#ifndef ALERT_FRAME_H_INCLUDED
+#define ALERT_FRAME_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// bytes of a field inside the encoded frame, NOT nul terminated
+typedef struct {
+    const char *data;
+    size_t size;
+} alert_span_t;
+
+// fields of an encoded ALERT, valid as long as the scanned frame is
+struct _alert_frame_t {
+    alert_span_t encoded;       // whole frame
+    alert_span_t aux;           // whole hash, including the count of items
+    uint64_t time;
+    uint32_t ttl;
+    alert_span_t rule;
+    alert_span_t name;
+    alert_span_t state;
+    alert_span_t severity;
+    alert_span_t description;
+    alert_span_t metadata;
+    alert_span_t action;        // whole list, including the count of items
+};
+
+// check the scanner against the fty_proto codec, learning its signature;
+// alert_frame_scan () fails until the check passes
+// returns true if the scanner reads what the codec writes
+FTY_ALERT_LIST_EXPORT bool
+    alert_frame_probe (void);
+
+// scan encoded ALERT 'data' of 'size' bytes into 'self', no memory is allocated
+// 0 - success, -1 - not an ALERT, malformed or scanner not probed
+FTY_ALERT_LIST_EXPORT int
+    alert_frame_scan_buffer (alert_frame_t *self, const byte *data, size_t size);
+
+// scan ALERT encoded in the first frame of 'msg' into 'self'
+// 0 - success, -1 - not an ALERT, malformed or scanner not probed
+FTY_ALERT_LIST_EXPORT int
+    alert_frame_scan (alert_frame_t *self, zmsg_t *msg);
+
+// iterate actions of scanned 'self'; start with *cursor = 0
+// returns false when there are no more actions
+FTY_ALERT_LIST_EXPORT bool
+    alert_frame_action_next (const alert_frame_t *self, size_t *cursor, alert_span_t *action);
+
+// iterate aux items of scanned 'self'; start with *cursor = 0
+// returns false when there are no more items
+FTY_ALERT_LIST_EXPORT bool
+    alert_frame_aux_next (const alert_frame_t *self, size_t *cursor, alert_span_t *key, alert_span_t *value);
+
+// find value of aux item 'key' of scanned 'self'
+// returns false if there is no such item
+FTY_ALERT_LIST_EXPORT bool
+    alert_frame_aux_find (const alert_frame_t *self, const char *key, alert_span_t *value);
+
+// decode scanned 'self' into a new alert, like fty_proto_decode () would;
+// the scanned message is left intact
+// returns new alert, NULL on failure
+FTY_ALERT_LIST_EXPORT fty_proto_t *
+    alert_frame_decode (const alert_frame_t *self);
+
+// encode scanned 'self' with aux item 'key' set to 'value', reusing the
+// scanned bytes of all other fields
+// returns new message, NULL on failure
+FTY_ALERT_LIST_EXPORT zmsg_t *
+    alert_frame_encode_aux (const alert_frame_t *self, const char *key, const char *value);
+
+// is 'span' equal to 'string'?
+FTY_ALERT_LIST_EXPORT bool
+    alert_span_streq (alert_span_t span, const char *string);
+
+// copy 'span' into 'buffer' of 'size' bytes as a c-string, truncated if needed
+// (string fields are never longer than 255 bytes)
+// returns 'buffer'
+FTY_ALERT_LIST_EXPORT char *
+    alert_span_copy (alert_span_t span, char *buffer, size_t size);
+
+//  Self test of this class
+FTY_ALERT_LIST_EXPORT void
+    alert_frame_test (bool verbose);
+
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
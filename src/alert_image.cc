@@ -0,0 +1,733 @@
+/*  =========================================================================
+    alert_image - Binary memory-mappable state file
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/*
+@header
+    alert_image - Binary memory-mappable state file
+@discuss
+    The image is a header, an array of fixed-size records and a string
+    table. Records refer to strings by their offset in the table, every
+    distinct string is stored once, so the thousands of alerts sharing
+    rules, elements, severities and actions cost a few bytes each.
+
+    The file is mapped and used in place: loading an alert reads its record
+    and points at its strings, nothing is parsed. The CRC-32C in the header
+    covers records and strings.
+
+    Numbers are little endian, like on the appliances; on a big endian host
+    images are neither read nor written and the ZPL format is used instead.
+@end
+*/
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "fty_alert_list_classes.h"
+
+struct _alert_image_t {
+    const char *data;           // mapped file
+    size_t size;
+    const alert_image_header_t *header;
+    const char *records;
+    const char *strings;
+};
+
+static bool
+s_little_endian (void)
+{
+    const uint16_t probe = 1;
+    return *(const uint8_t *) &probe == 1;
+}
+
+alert_image_t *
+alert_image_open (const char *path, const char *filename)
+{
+    assert (path);
+    assert (filename);
+    if (!s_little_endian ())
+        return NULL;
+
+    char *image_file = zsys_sprintf ("%s/%s", path, filename);
+    int fd = image_file ? open (image_file, O_RDONLY | O_CLOEXEC) : -1;
+    struct stat st;
+    if (fd == -1 || fstat (fd, &st) == -1 || (size_t) st.st_size < sizeof (alert_image_header_t)) {
+        if (fd != -1)
+            close (fd);
+        zstr_free (&image_file);
+        return NULL;
+    }
+    size_t size = (size_t) st.st_size;
+    void *data = mmap (NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close (fd);
+    if (data == MAP_FAILED) {
+        log_error ("cannot map %s: %s", image_file, strerror (errno));
+        zstr_free (&image_file);
+        return NULL;
+    }
+    madvise (data, size, MADV_SEQUENTIAL);
+
+    const alert_image_header_t *header = (const alert_image_header_t *) data;
+    const char *error = NULL;
+    if (memcmp (header->magic, ALERT_IMAGE_MAGIC, sizeof (header->magic)) != 0)
+        error = "";     // not an image, no need to complain
+    else
+    if (header->version != ALERT_IMAGE_VERSION || header->record_size < sizeof (alert_image_record_t))
+        error = "unsupported version";
+    else
+    if (header->count > (size - sizeof (alert_image_header_t)) / header->record_size ||
+            header->strings_size == 0 ||
+            sizeof (alert_image_header_t) + header->count * header->record_size + header->strings_size != size)
+        error = "truncated";
+    else
+    if (((const char *) data) [size - 1] != '\0')
+        error = "corrupted string table";
+    else
+    if (alert_crc32c (0, (const char *) data + sizeof (alert_image_header_t),
+            size - sizeof (alert_image_header_t)) != header->crc)
+        error = "checksum mismatch";
+
+    if (error) {
+        if (*error)
+            log_error ("state image %s: %s", image_file, error);
+        munmap (data, size);
+        zstr_free (&image_file);
+        return NULL;
+    }
+    zstr_free (&image_file);
+
+    alert_image_t *self = (alert_image_t *) zmalloc (sizeof (alert_image_t));
+    if (!self) {
+        munmap (data, size);
+        return NULL;
+    }
+    self->data = (const char *) data;
+    self->size = size;
+    self->header = header;
+    self->records = self->data + sizeof (alert_image_header_t);
+    self->strings = self->records + header->count * header->record_size;
+    return self;
+}
+
+void
+alert_image_destroy (alert_image_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        alert_image_t *self = *self_p;
+        munmap ((void *) self->data, self->size);
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+size_t
+alert_image_count (alert_image_t *self)
+{
+    assert (self);
+    return (size_t) self->header->count;
+}
+
+const alert_image_record_t *
+alert_image_record (alert_image_t *self, size_t index)
+{
+    assert (self);
+    if (index >= self->header->count)
+        return NULL;
+    return (const alert_image_record_t *) (self->records + index * self->header->record_size);
+}
+
+const char *
+alert_image_str (alert_image_t *self, uint32_t offset)
+{
+    assert (self);
+    if (offset >= self->header->strings_size)
+        return "";
+    return self->strings + offset;
+}
+
+// call 'item' on each part of 'string' separated by ALERT_IMAGE_SEPARATOR
+template <typename Item> static void
+s_split (const char *string, Item item)
+{
+    while (*string) {
+        const char *end = strchr (string, ALERT_IMAGE_SEPARATOR);
+        size_t length = end ? (size_t) (end - string) : strlen (string);
+        item (string, length);
+        string += length + (end ? 1 : 0);
+    }
+}
+
+fty_proto_t *
+alert_image_decode (alert_image_t *self, size_t index)
+{
+    const alert_image_record_t *record = alert_image_record (self, index);
+    if (!record)
+        return NULL;
+
+    fty_proto_t *alert = fty_proto_new (FTY_PROTO_ALERT);
+    if (!alert)
+        return NULL;
+    fty_proto_set_time (alert, record->time);
+    fty_proto_set_ttl (alert, record->ttl);
+    fty_proto_set_rule (alert, "%s", alert_image_str (self, record->rule));
+    fty_proto_set_name (alert, "%s", alert_image_str (self, record->name));
+    fty_proto_set_state (alert, "%s", alert_image_str (self, record->state_name));
+    fty_proto_set_severity (alert, "%s", alert_image_str (self, record->severity));
+    fty_proto_set_description (alert, "%s", alert_image_str (self, record->description));
+    fty_proto_set_metadata (alert, "%s", alert_image_str (self, record->metadata));
+
+    zlist_t *actions = zlist_new ();
+    zlist_autofree (actions);
+    s_split (alert_image_str (self, record->actions), [&] (const char *action, size_t length) {
+        std::string item (action, length);
+        zlist_append (actions, (void *) item.c_str ());
+    });
+    fty_proto_set_action (alert, &actions);
+
+    zhash_t *aux = zhash_new ();
+    zhash_autofree (aux);
+    s_split (alert_image_str (self, record->aux), [&] (const char *pair, size_t length) {
+        std::string item (pair, length);
+        size_t assign = item.find (ALERT_IMAGE_ASSIGN);
+        if (assign != std::string::npos)
+            zhash_update (aux, item.substr (0, assign).c_str (), (void *) (item.c_str () + assign + 1));
+    });
+    if (record->deadline)
+        zhash_update (aux, STATE_AUX_DEADLINE, (void *) std::to_string (record->deadline).c_str ());
+    if (record->last_sent)
+        zhash_update (aux, STATE_AUX_LAST_SENT, (void *) std::to_string (record->last_sent).c_str ());
+    fty_proto_set_aux (alert, &aux);
+    return alert;
+}
+
+// string table under construction, each distinct string stored once
+class s_string_table {
+    public:
+        // offsets are 32 bits, the table can't grow over 'limit' bytes
+        s_string_table (size_t limit = UINT32_MAX) : m_table (1, '\0'), m_limit (limit) {}
+
+        // returns offset of 'string', 0 once the table overflowed
+        uint32_t add (const std::string &string) {
+            if (string.empty () || m_overflow)
+                return 0;
+            auto it = m_offsets.find (string);
+            if (it != m_offsets.end ())
+                return it->second;
+            if (m_table.size () + string.size () + 1 > m_limit) {
+                m_overflow = true;
+                return 0;
+            }
+            uint32_t offset = (uint32_t) m_table.size ();
+            m_table.append (string);
+            m_table.push_back ('\0');
+            m_offsets.emplace (string, offset);
+            return offset;
+        }
+
+        uint32_t add (const char *string) {
+            return add (std::string (string ? string : ""));
+        }
+
+        const std::string &table () const { return m_table; }
+
+        // strings didn't fit, the image can't be made
+        bool overflow () const { return m_overflow; }
+
+    private:
+        std::string m_table;
+        size_t m_limit;
+        bool m_overflow = false;
+        std::unordered_map<std::string, uint32_t> m_offsets;
+};
+
+// fill 'record' of 'alert', adding its strings to 'strings'
+static void
+s_record_encode (alert_image_record_t &record, fty_proto_t *alert, s_string_table &strings)
+{
+    static thread_local std::string joined;
+
+    memset (&record, 0, sizeof (record));
+    record.time = fty_proto_time (alert);
+    record.ttl = fty_proto_ttl (alert);
+    record.state = (uint32_t) alert_state_from_string (fty_proto_state (alert));
+    record.rule = strings.add (fty_proto_rule (alert));
+    record.name = strings.add (fty_proto_name (alert));
+    record.state_name = strings.add (fty_proto_state (alert));
+    record.severity = strings.add (fty_proto_severity (alert));
+    record.description = strings.add (fty_proto_description (alert));
+    record.metadata = strings.add (fty_proto_metadata (alert));
+
+    joined.clear ();
+    zlist_t *actions = fty_proto_action (alert);
+    for (const char *action = actions ? (const char *) zlist_first (actions) : NULL;
+            action; action = (const char *) zlist_next (actions)) {
+        if (!joined.empty ())
+            joined.push_back (ALERT_IMAGE_SEPARATOR);
+        joined.append (action);
+    }
+    record.actions = strings.add (joined);
+
+    joined.clear ();
+    zhash_t *aux = fty_proto_aux (alert);
+    for (const char *value = aux ? (const char *) zhash_first (aux) : NULL;
+            value; value = (const char *) zhash_next (aux)) {
+        if (streq (zhash_cursor (aux), STATE_AUX_DEADLINE)) {
+            record.deadline = strtoll (value, NULL, 10);
+            continue;
+        }
+        if (streq (zhash_cursor (aux), STATE_AUX_LAST_SENT)) {
+            record.last_sent = strtoll (value, NULL, 10);
+            continue;
+        }
+        if (!joined.empty ())
+            joined.push_back (ALERT_IMAGE_SEPARATOR);
+        joined.append (zhash_cursor (aux));
+        joined.push_back (ALERT_IMAGE_ASSIGN);
+        joined.append (value);
+    }
+    record.aux = strings.add (joined);
+}
+
+// header of image of 'count' records and 'strings_size' bytes of strings
+// with checksum 'crc'
+static alert_image_header_t
+s_header (size_t count, size_t strings_size, uint32_t crc)
+{
+    alert_image_header_t header;
+    memset (&header, 0, sizeof (header));
+    memcpy (header.magic, ALERT_IMAGE_MAGIC, sizeof (header.magic));
+    header.version = ALERT_IMAGE_VERSION;
+    header.record_size = sizeof (alert_image_record_t);
+    header.count = count;
+    header.strings_size = strings_size;
+    header.crc = crc;
+    return header;
+}
+
+zchunk_t *
+alert_image_encode (zlistx_t *alerts)
+{
+    return alert_image_encode_records (alerts, NULL, NULL, 0);
+}
+
+zchunk_t *
+alert_image_encode_records (zlistx_t *alerts, alert_image_t *base, const size_t *indexes, size_t count)
+{
+    if (!alerts || (count && (!base || !indexes)) || !s_little_endian ())
+        return NULL;
+
+    s_string_table strings;
+    std::vector<alert_image_record_t> records;
+    records.reserve (zlistx_size (alerts) + count);
+    fty_proto_t *cursor = (fty_proto_t *) zlistx_first (alerts);
+    while (cursor) {
+        records.emplace_back ();
+        s_record_encode (records.back (), cursor, strings);
+        cursor = (fty_proto_t *) zlistx_next (alerts);
+    }
+    // records of 'base' keep their fields, strings move to the new table
+    for (size_t i = 0; i < count; i++) {
+        const alert_image_record_t *record = alert_image_record (base, indexes [i]);
+        if (!record)
+            continue;
+        records.push_back (*record);
+        alert_image_record_t &copy = records.back ();
+        uint32_t *offsets [] = { &copy.rule, &copy.name, &copy.state_name, &copy.severity,
+            &copy.description, &copy.metadata, &copy.actions, &copy.aux };
+        for (uint32_t *offset : offsets)
+            *offset = strings.add (alert_image_str (base, *offset));
+    }
+
+    if (strings.overflow ()) {
+        log_error ("strings of %zu alerts exceed the state image", records.size ());
+        return NULL;
+    }
+
+    uint32_t crc = alert_crc32c (0, records.data (), records.size () * sizeof (alert_image_record_t));
+    crc = alert_crc32c (crc, strings.table ().data (), strings.table ().size ());
+    alert_image_header_t header = s_header (records.size (), strings.table ().size (), crc);
+
+    size_t size = sizeof (header) + records.size () * sizeof (alert_image_record_t) + strings.table ().size ();
+    zchunk_t *image = zchunk_new (NULL, size);
+    if (!image)
+        return NULL;
+    zchunk_extend (image, &header, sizeof (header));
+    zchunk_extend (image, records.data (), records.size () * sizeof (alert_image_record_t));
+    zchunk_extend (image, strings.table ().data (), strings.table ().size ());
+    return image;
+}
+
+int
+alert_image_write (zchunk_t *image, const char *path, const char *filename)
+{
+    if (!image)
+        return -1;
+    return alert_state_write (path, filename, zchunk_data (image), zchunk_size (image));
+}
+
+int
+alert_image_save (zlistx_t *alerts, const char *path, const char *filename)
+{
+    zchunk_t *image = alert_image_encode (alerts);
+    int rv = alert_image_write (image, path, filename);
+    zchunk_destroy (&image);
+    return rv;
+}
+
+struct _alert_image_writer_t {
+    char *path;
+    char *name;
+    char *filename;             // path/name
+    char *temporary;            // path/name STATE_TEMPORARY_SUFFIX
+    FILE *file;
+    s_string_table strings;
+    size_t count;
+    uint32_t crc;               // of the records written so far
+    bool failed;
+};
+
+alert_image_writer_t *
+alert_image_writer_new (const char *path, const char *filename)
+{
+    assert (path);
+    assert (filename);
+    if (!s_little_endian ())
+        return NULL;
+    alert_image_writer_t *self = new (std::nothrow) alert_image_writer_t;
+    if (!self)
+        return NULL;
+    self->path = strdup (path);
+    self->name = strdup (filename);
+    self->filename = zsys_sprintf ("%s/%s", path, filename);
+    self->temporary = zsys_sprintf ("%s/%s%s", path, filename, STATE_TEMPORARY_SUFFIX);
+    self->file = self->temporary ? fopen (self->temporary, "wbe") : NULL;
+    self->count = 0;
+    self->crc = 0;
+    self->failed = false;
+    // header is written last, when the sizes are known
+    alert_image_header_t header = s_header (0, 0, 0);
+    if (!self->file || fwrite (&header, sizeof (header), 1, self->file) != 1) {
+        log_error ("cannot write state image %s/%s", path, filename);
+        if (self->file) {
+            fclose (self->file);
+            unlink (self->temporary);
+        }
+        zstr_free (&self->path);
+        zstr_free (&self->name);
+        zstr_free (&self->filename);
+        zstr_free (&self->temporary);
+        delete self;
+        return NULL;
+    }
+    setvbuf (self->file, NULL, _IOFBF, 1 << 20);
+    return self;
+}
+
+void
+alert_image_writer_destroy (alert_image_writer_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        alert_image_writer_t *self = *self_p;
+        if (self->file) {
+            // not closed, discard
+            fclose (self->file);
+            unlink (self->temporary);
+        }
+        zstr_free (&self->path);
+        zstr_free (&self->name);
+        zstr_free (&self->filename);
+        zstr_free (&self->temporary);
+        delete self;
+        *self_p = NULL;
+    }
+}
+
+int
+alert_image_writer_add (alert_image_writer_t *self, fty_proto_t *alert)
+{
+    assert (self);
+    assert (alert);
+    if (!self->file || self->failed)
+        return -1;
+    alert_image_record_t record;
+    s_record_encode (record, alert, self->strings);
+    if (self->strings.overflow ()) {
+        log_error ("strings of %zu alerts exceed state image %s", self->count + 1, self->filename);
+        self->failed = true;
+        return -1;
+    }
+    if (fwrite (&record, sizeof (record), 1, self->file) != 1) {
+        self->failed = true;
+        return -1;
+    }
+    self->crc = alert_crc32c (self->crc, &record, sizeof (record));
+    self->count++;
+    return 0;
+}
+
+size_t
+alert_image_writer_count (alert_image_writer_t *self)
+{
+    assert (self);
+    return self->count;
+}
+
+int
+alert_image_writer_close (alert_image_writer_t *self)
+{
+    assert (self);
+    if (!self->file)
+        return -1;
+    const std::string &table = self->strings.table ();
+    alert_image_header_t header = s_header (self->count, table.size (),
+        alert_crc32c (self->crc, table.data (), table.size ()));
+    bool written = !self->failed &&
+        fwrite (table.data (), 1, table.size (), self->file) == table.size () &&
+        fseek (self->file, 0, SEEK_SET) == 0 &&
+        fwrite (&header, sizeof (header), 1, self->file) == 1 &&
+        fflush (self->file) == 0 &&
+        fsync (fileno (self->file)) == 0;
+    if (fclose (self->file) != 0)
+        written = false;
+    self->file = NULL;
+    if (!written) {
+        log_error ("cannot write state image %s", self->filename);
+        unlink (self->temporary);
+        return -1;
+    }
+    return alert_state_install (self->path, self->name);
+}
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+alert_image_test (bool verbose)
+{
+    printf (" * alert_image: ");
+
+    //  @selftest
+    const char *path = ".";
+    const char *filename = "test_alert_image";
+
+    zlistx_t *alerts = zlistx_new ();
+    zlistx_set_destructor (alerts, (czmq_destructor *) fty_proto_destroy);
+    for (int i = 0; i < 100; i++) {
+        zlist_t *actions = zlist_new ();
+        zlist_autofree (actions);
+        zlist_append (actions, (void *) "EMAIL");
+        if (i % 2)
+            zlist_append (actions, (void *) "SMS");
+        char element [64];
+        snprintf (element, sizeof (element), "ŽlUťOUčKý kůň %d", i);
+        fty_proto_t *alert = alert_new (i % 3 ? "Rule1" : "Rule2", element,
+            i % 4 ? "ACTIVE" : "RESOLVED", "CRITICAL", "description", 1000 + i, &actions, 0);
+        fty_proto_set_ttl (alert, 60);
+        fty_proto_aux_insert (alert, "ctime", "%d", i);
+        if (i == 1) {
+            fty_proto_aux_insert (alert, STATE_AUX_DEADLINE, "%d", 1600000000);
+            fty_proto_aux_insert (alert, STATE_AUX_LAST_SENT, "%d", 1599999000);
+        }
+        if (i == 0)
+            fty_proto_set_metadata (alert, "%s", "{ \"key\": \"value\" }");
+        zlistx_add_end (alerts, alert);
+    }
+    assert (alert_image_save (alerts, path, filename) == 0);
+
+    alert_image_t *image = alert_image_open (path, filename);
+    assert (image);
+    assert (alert_image_count (image) == 100);
+    assert (alert_image_record (image, 100) == NULL);
+    assert (streq (alert_image_str (image, 0xffffffff), ""));
+    const alert_image_record_t *record = alert_image_record (image, 1);
+    assert (record);
+    assert (record->time == 1001);
+    assert (record->state == ALERT_STATE_ACTIVE);
+    assert (streq (alert_image_str (image, record->rule), "Rule1"));
+    // times kept in the record, not in the aux string
+    assert (record->deadline == 1600000000);
+    assert (record->last_sent == 1599999000);
+    assert (strstr (alert_image_str (image, record->aux), STATE_AUX_DEADLINE) == NULL);
+    // shared strings are stored once
+    assert (alert_image_record (image, 2)->severity == record->severity);
+
+    assert (alert_image_decode (image, 100) == NULL);
+    fty_proto_t *expected = (fty_proto_t *) zlistx_first (alerts);
+    for (size_t index = 0; expected; index++) {
+        fty_proto_t *actual = alert_image_decode (image, index);
+        assert (actual);
+        assert (alert_comparator (expected, actual) == 0);
+        assert (fty_proto_ttl (actual) == 60);
+        assert (streq (fty_proto_metadata (actual), fty_proto_metadata (expected)));
+        assert (fty_proto_aux_number (actual, "ctime", 1000) == fty_proto_aux_number (expected, "ctime", 0));
+        assert (fty_proto_aux_number (actual, STATE_AUX_DEADLINE, 0) == fty_proto_aux_number (expected, STATE_AUX_DEADLINE, 0));
+        assert (fty_proto_aux_number (actual, STATE_AUX_LAST_SENT, 0) == fty_proto_aux_number (expected, STATE_AUX_LAST_SENT, 0));
+        fty_proto_destroy (&actual);
+        expected = (fty_proto_t *) zlistx_next (alerts);
+    }
+    alert_image_destroy (&image);
+    assert (image == NULL);
+
+    // corrupted and foreign files are refused
+    {
+        FILE *file = fopen ("./test_alert_image", "r+b");
+        assert (file);
+        fseek (file, sizeof (alert_image_header_t) + 10, SEEK_SET);
+        fputc ('x', file);
+        fclose (file);
+        assert (alert_image_open (path, filename) == NULL);
+
+        assert (alert_image_save (alerts, path, filename) == 0);
+        assert (truncate ("./test_alert_image", sizeof (alert_image_header_t) + 10) == 0);
+        assert (alert_image_open (path, filename) == NULL);
+
+        assert (alert_image_open ("src/selftest-ro", "old_state_file") == NULL);
+        assert (alert_image_open (path, "does_not_exist") == NULL);
+    }
+
+    // records of another image are copied as they are
+    {
+        assert (alert_image_save (alerts, path, filename) == 0);
+        alert_image_t *source = alert_image_open (path, filename);
+        assert (source);
+        size_t indexes [] = { 99, 0 };
+        zlistx_t *first = zlistx_new ();
+        zlistx_set_destructor (first, (czmq_destructor *) fty_proto_destroy);
+        zlistx_add_end (first, alert_image_decode (source, 50));
+        zchunk_t *chunk = alert_image_encode_records (first, source, indexes, 2);
+        assert (chunk);
+        assert (alert_image_write (chunk, path, "test_alert_image_records") == 0);
+        zchunk_destroy (&chunk);
+
+        alert_image_t *copied = alert_image_open (path, "test_alert_image_records");
+        assert (copied);
+        assert (alert_image_count (copied) == 3);
+        size_t expected [] = { 50, 99, 0 };
+        for (size_t i = 0; i < 3; i++) {
+            fty_proto_t *alert = alert_image_decode (copied, i);
+            fty_proto_t *original = alert_image_decode (source, expected [i]);
+            assert (streq (fty_proto_name (alert), fty_proto_name (original)));
+            assert (streq (fty_proto_description (alert), fty_proto_description (original)));
+            assert (fty_proto_time (alert) == fty_proto_time (original));
+            assert (alert_image_record (copied, i)->deadline == alert_image_record (source, expected [i])->deadline);
+            fty_proto_destroy (&alert);
+            fty_proto_destroy (&original);
+        }
+        alert_image_destroy (&copied);
+        alert_image_destroy (&source);
+        zlistx_destroy (&first);
+        zsys_file_delete ("./test_alert_image_records");
+        zsys_file_delete ("./test_alert_image_records.prev");
+    }
+
+    // string table over its limit is refused, not wrapped
+    {
+        s_string_table strings (8);
+        assert (strings.add ("abc") == 1);
+        assert (strings.add ("abc") == 1);
+        assert (!strings.overflow ());
+        assert (strings.add ("defg") == 0);
+        assert (strings.overflow ());
+        assert (strings.add ("x") == 0);
+    }
+
+    // image written one alert at a time is the same
+    {
+        alert_image_writer_t *writer = alert_image_writer_new (path, "test_alert_image_stream");
+        assert (writer);
+        for (fty_proto_t *alert = (fty_proto_t *) zlistx_first (alerts); alert;
+                alert = (fty_proto_t *) zlistx_next (alerts))
+            assert (alert_image_writer_add (writer, alert) == 0);
+        assert (alert_image_writer_count (writer) == 100);
+        assert (alert_image_writer_close (writer) == 0);
+        alert_image_writer_destroy (&writer);
+        assert (writer == NULL);
+
+        zchunk_t *expected = alert_image_encode (alerts);
+        assert (expected);
+        zfile_t *file = zfile_new (path, "test_alert_image_stream");
+        assert (file && zfile_input (file) == 0);
+        zchunk_t *actual = zfile_read (file, zfile_cursize (file), 0);
+        assert (actual);
+        assert (zchunk_size (actual) == zchunk_size (expected));
+        assert (memcmp (zchunk_data (actual), zchunk_data (expected), zchunk_size (expected)) == 0);
+        zchunk_destroy (&actual);
+        zchunk_destroy (&expected);
+        zfile_destroy (&file);
+
+        // writer not closed leaves nothing behind
+        writer = alert_image_writer_new (path, "test_alert_image_discarded");
+        assert (writer);
+        assert (alert_image_writer_add (writer, (fty_proto_t *) zlistx_first (alerts)) == 0);
+        alert_image_writer_destroy (&writer);
+        assert (!zsys_file_exists ("./test_alert_image_discarded"));
+        assert (!zsys_file_exists ("./test_alert_image_discarded.tmp"));
+        zsys_file_delete ("./test_alert_image_stream");
+        zsys_file_delete ("./test_alert_image_stream.prev");
+    }
+
+    // empty cache
+    {
+        zlistx_t *empty = zlistx_new ();
+        assert (alert_image_save (empty, path, filename) == 0);
+        image = alert_image_open (path, filename);
+        assert (image);
+        assert (alert_image_count (image) == 0);
+        alert_image_destroy (&image);
+        zlistx_destroy (&empty);
+    }
+
+    // load time of a large cache
+    if (verbose) {
+        zlistx_purge (alerts);
+        for (int i = 0; i < 10000; i++) {
+            zlist_t *actions = zlist_new ();
+            zlist_autofree (actions);
+            zlist_append (actions, (void *) "EMAIL");
+            char element [32];
+            snprintf (element, sizeof (element), "ups-%d", i);
+            zlistx_add_end (alerts, alert_new ("Rule1", element, "ACTIVE", "CRITICAL", "description", i, &actions, 0));
+        }
+        assert (alert_image_save (alerts, path, filename) == 0);
+        int64_t start = zclock_mono ();
+        image = alert_image_open (path, filename);
+        assert (image && alert_image_count (image) == 10000);
+        for (size_t index = 0; index < 10000; index++) {
+            fty_proto_t *alert = alert_image_decode (image, index);
+            assert (alert);
+            fty_proto_destroy (&alert);
+        }
+        log_info ("10000 alerts decoded from the image in %" PRIi64 " ms", zclock_mono () - start);
+        alert_image_destroy (&image);
+    }
+
+    zlistx_destroy (&alerts);
+    zsys_file_delete ("./test_alert_image");
+    zsys_file_delete ("./test_alert_image.prev");
+    //  @end
+
+    printf ("OK\n");
+}
@@ -0,0 +1,146 @@
+/*  =========================================================================
+    alert_image - Binary memory-mappable state file
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#ifndef ALERT_IMAGE_H_INCLUDED
+#define ALERT_IMAGE_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ALERT_IMAGE_MAGIC       "FTYALIMG"
+#define ALERT_IMAGE_VERSION     1
+
+// header of the file, all numbers are little endian
+typedef struct {
+    char magic [8];             // ALERT_IMAGE_MAGIC
+    uint32_t version;           // ALERT_IMAGE_VERSION
+    uint32_t record_size;       // size of a record, newer versions may append fields
+    uint64_t count;             // number of records
+    uint64_t strings_size;      // size of the string table
+    uint32_t crc;               // CRC-32C of records and string table
+    uint32_t flags;             // reserved, 0
+    uint64_t reserved [3];
+} alert_image_header_t;
+
+// record of one alert, strings are offsets into the string table
+typedef struct {
+    uint64_t time;
+    uint32_t ttl;
+    uint32_t state;             // alert_state_t
+    uint32_t rule;
+    uint32_t name;
+    uint32_t state_name;        // fty_proto_state () as it was
+    uint32_t severity;
+    uint32_t description;
+    uint32_t metadata;
+    uint32_t actions;           // actions separated by ALERT_IMAGE_SEPARATOR
+    uint32_t aux;               // key ALERT_IMAGE_ASSIGN value, separated by ALERT_IMAGE_SEPARATOR
+    int64_t deadline;           // aux STATE_AUX_DEADLINE, 0 - none
+    int64_t last_sent;          // aux STATE_AUX_LAST_SENT, 0 - none
+} alert_image_record_t;
+
+#define ALERT_IMAGE_SEPARATOR   '\x1f'
+#define ALERT_IMAGE_ASSIGN      '\x1e'
+
+// map image file 'filename' in 'path' and verify it
+// returns new image, NULL if the file is missing, not an image or corrupted
+FTY_ALERT_LIST_EXPORT alert_image_t *
+    alert_image_open (const char *path, const char *filename);
+
+// unmap the image
+FTY_ALERT_LIST_EXPORT void
+    alert_image_destroy (alert_image_t **self_p);
+
+// number of alerts in the image
+FTY_ALERT_LIST_EXPORT size_t
+    alert_image_count (alert_image_t *self);
+
+// record of alert 'index' of the image, NULL if out of range
+FTY_ALERT_LIST_EXPORT const alert_image_record_t *
+    alert_image_record (alert_image_t *self, size_t index);
+
+// string at 'offset' of the string table, "" if out of range
+FTY_ALERT_LIST_EXPORT const char *
+    alert_image_str (alert_image_t *self, uint32_t offset);
+
+// decode alert 'index' of the image
+// returns new alert, NULL if out of range
+FTY_ALERT_LIST_EXPORT fty_proto_t *
+    alert_image_decode (alert_image_t *self, size_t index);
+
+// encode 'alerts' into an image in memory; 'alerts' are only read
+// returns new image, NULL on error or on a big endian host
+FTY_ALERT_LIST_EXPORT zchunk_t *
+    alert_image_encode (zlistx_t *alerts);
+
+// encode 'alerts' followed by 'count' records of image 'base' at 'indexes',
+// copied without decoding, into an image in memory; 'alerts' are only read
+// returns new image, NULL on error or on a big endian host
+FTY_ALERT_LIST_EXPORT zchunk_t *
+    alert_image_encode_records (zlistx_t *alerts, alert_image_t *base, const size_t *indexes, size_t count);
+
+// write 'image' made by alert_image_encode () to file 'filename' in 'path',
+// with alert_state_write ()
+// 0 - success, -1 - error
+FTY_ALERT_LIST_EXPORT int
+    alert_image_write (zchunk_t *image, const char *path, const char *filename);
+
+// write 'alerts' to image file 'filename' in 'path'
+// 0 - success, -1 - error
+FTY_ALERT_LIST_EXPORT int
+    alert_image_save (zlistx_t *alerts, const char *path, const char *filename);
+
+// open image file 'filename' in 'path' for writing alerts one at a time:
+// records go to a temporary file, only the string table is kept in memory
+// returns new writer, NULL on error or on a big endian host
+FTY_ALERT_LIST_EXPORT alert_image_writer_t *
+    alert_image_writer_new (const char *path, const char *filename);
+
+// discard the image, unless it was closed
+FTY_ALERT_LIST_EXPORT void
+    alert_image_writer_destroy (alert_image_writer_t **self_p);
+
+// append 'alert' to the image
+// 0 - success, -1 - error
+FTY_ALERT_LIST_EXPORT int
+    alert_image_writer_add (alert_image_writer_t *self, fty_proto_t *alert);
+
+// number of alerts appended
+FTY_ALERT_LIST_EXPORT size_t
+    alert_image_writer_count (alert_image_writer_t *self);
+
+// complete the image, sync it and rename it over 'filename'
+// 0 - success, -1 - error
+FTY_ALERT_LIST_EXPORT int
+    alert_image_writer_close (alert_image_writer_t *self);
+
+//  Self test of this class
+FTY_ALERT_LIST_EXPORT void
+    alert_image_test (bool verbose);
+
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,299 @@
+/*  =========================================================================
+    alert_intern - Interning pool for alert attributes
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/*
+@header
+    alert_intern - Interning pool for alert attributes
+@discuss
+    Thousands of alerts share a few hundred rule names, element names and
+    action lists. The pool keeps one immutable copy of each such value, so
+    the alert cache can reference it and compare it by pointer.
+
+    Values are never released: the vocabulary of rules, assets and actions
+    of an appliance is bounded. They are packed in an arena, lookup keys are
+    built in a per-thread scratch arena, so a lookup of a known value doesn't
+    touch the heap.
+@end
+*/
+
+#include <mutex>
+#include <unordered_set>
+#include "fty_alert_list_classes.h"
+
+// separates the parts of composite keys (identity, action set)
+#define INTERN_SEPARATOR '\x1f'
+
+// FNV-1a of a c-string
+struct s_hash {
+    size_t operator() (const char *key) const {
+        uint64_t hash = 14695981039346656037ULL;
+        for (const unsigned char *c = (const unsigned char *) key; *c; c++)
+            hash = (hash ^ *c) * 1099511628211ULL;
+        return (size_t) hash;
+    }
+};
+
+struct s_equal {
+    bool operator() (const char *key1, const char *key2) const {
+        return streq (key1, key2);
+    }
+};
+
+typedef std::unordered_set<const char *, s_hash, s_equal> intern_pool_t;
+
+static std::mutex s_intern_mtx;
+static intern_pool_t s_strings;
+static intern_pool_t s_identities;
+static intern_pool_t s_actions;
+static alert_arena_t *s_storage = NULL;     // pooled values, never reset
+
+// arena for lookup keys of the calling thread, reset by each lookup
+struct s_scratch_t {
+    alert_arena_t *arena;
+    s_scratch_t () : arena (alert_arena_new (1024)) {}
+    ~s_scratch_t () { alert_arena_destroy (&arena); }
+};
+
+static alert_arena_t *
+s_scratch (void)
+{
+    static thread_local s_scratch_t scratch;
+    alert_arena_reset (scratch.arena);
+    return scratch.arena;
+}
+
+// copy 'source' to 'target' folding case of ASCII characters
+// returns the end of the copy
+// Both alert_id_comparator () comparisons (strcasecmp () of the rule and
+// UTF8::utf8eq () of the element) ignore the case of ASCII characters only,
+// so folding ASCII and keeping multi-byte sequences verbatim is equivalent.
+
+static char *
+s_fold (char *target, const char *source)
+{
+    for (const char *c = source; *c; c++)
+        *target++ = (*c & 0x80) ? *c : (char) tolower (*c);
+    return target;
+}
+
+// build identity key of ('rule', 'element') in scratch arena
+static const char *
+s_identity_key (const char *rule, const char *element)
+{
+    char *key = (char *) alert_arena_alloc (s_scratch (), strlen (rule) + strlen (element) + 2);
+    if (!key)
+        return NULL;
+    char *end = s_fold (key, rule);
+    *end++ = INTERN_SEPARATOR;
+    end = s_fold (end, element);
+    *end = 0;
+    return key;
+}
+
+static const char *
+s_intern (intern_pool_t &pool, const char *key)
+{
+    if (!key)
+        return NULL;
+    std::lock_guard<std::mutex> lock (s_intern_mtx);
+    auto it = pool.find (key);
+    if (it != pool.end ())
+        return *it;
+
+    if (!s_storage)
+        s_storage = alert_arena_new (16384);
+    const char *value = alert_arena_strdup (s_storage, key);
+    if (!value)
+        return NULL;
+    pool.insert (value);
+    return value;
+}
+
+const char *
+alert_intern_string (const char *string)
+{
+    return s_intern (s_strings, string);
+}
+
+const char *
+alert_intern_identity (const char *rule, const char *element)
+{
+    if (!rule || !element)
+        return NULL;
+    return s_intern (s_identities, s_identity_key (rule, element));
+}
+
+const char *
+alert_intern_identity_lookup (const char *rule, const char *element)
+{
+    if (!rule || !element)
+        return NULL;
+    const char *key = s_identity_key (rule, element);
+    if (!key)
+        return NULL;
+
+    std::lock_guard<std::mutex> lock (s_intern_mtx);
+    auto it = s_identities.find (key);
+    return it == s_identities.end () ? NULL : *it;
+}
+
+const char *
+alert_intern_actions (zlist_t *actions)
+{
+    size_t size = 1;
+    if (actions) {
+        for (const char *action = (const char *) zlist_first (actions); action;
+                action = (const char *) zlist_next (actions))
+            size += strlen (action) + 1;
+    }
+    char *key = (char *) alert_arena_alloc (s_scratch (), size);
+    if (!key)
+        return NULL;
+    char *end = key;
+    if (actions) {
+        for (const char *action = (const char *) zlist_first (actions); action;
+                action = (const char *) zlist_next (actions)) {
+            size_t length = strlen (action);
+            memcpy (end, action, length);
+            end += length;
+            *end++ = INTERN_SEPARATOR;
+        }
+    }
+    *end = 0;
+    return s_intern (s_actions, key);
+}
+
+const char *
+alert_intern_actions_frame (const alert_frame_t *frame)
+{
+    assert (frame);
+    // key is never longer than the encoded list
+    char *key = (char *) alert_arena_alloc (s_scratch (), frame->action.size + 1);
+    if (!key)
+        return NULL;
+    char *end = key;
+    size_t cursor = 0;
+    alert_span_t action;
+    while (alert_frame_action_next (frame, &cursor, &action)) {
+        memcpy (end, action.data, action.size);
+        end += action.size;
+        *end++ = INTERN_SEPARATOR;
+    }
+    *end = 0;
+    return s_intern (s_actions, key);
+}
+
+size_t
+alert_intern_size (void)
+{
+    std::lock_guard<std::mutex> lock (s_intern_mtx);
+    return s_strings.size () + s_identities.size () + s_actions.size ();
+}
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+alert_intern_test (bool verbose)
+{
+    printf (" * alert_intern: ");
+
+    //  @selftest
+    // strings
+    {
+        char buffer [] = "CRITICAL";
+        const char *critical = alert_intern_string ("CRITICAL");
+        assert (critical);
+        assert (streq (critical, "CRITICAL"));
+        assert (critical != buffer);
+        assert (alert_intern_string (buffer) == critical);
+        assert (alert_intern_string ("critical") != critical);
+        assert (alert_intern_string (NULL) == NULL);
+    }
+
+    // identities
+    {
+        assert (alert_intern_identity_lookup ("intern.rule@ups-1", "ups-1") == NULL);
+        const char *id = alert_intern_identity ("intern.rule@ups-1", "ups-1");
+        assert (id);
+        assert (alert_intern_identity_lookup ("intern.rule@ups-1", "ups-1") == id);
+        assert (alert_intern_identity ("Intern.Rule@UPS-1", "UPS-1") == id);
+        assert (alert_intern_identity ("intern.rule@ups-1", "ups-2") != id);
+        assert (alert_intern_identity ("intern.rule@ups-", "1ups-1") != id);
+        // identity and string pools don't mix
+        assert (alert_intern_string ("intern.rule@ups-1") != id);
+
+        const char *unicode = alert_intern_identity ("realpower.DeFault", "ŽlUťOUčKý kůň супер");
+        assert (alert_intern_identity ("realpower.default",
+            "Žluťoučk\xc3\xbd Ků\xc5\x88 супер") == unicode);
+        assert (alert_intern_identity ("realpower.default", "Žluťoučký kůň супер ") != unicode);
+
+        assert (alert_intern_identity (NULL, "ups-1") == NULL);
+        assert (alert_intern_identity ("intern.rule@ups-1", NULL) == NULL);
+        assert (alert_intern_identity_lookup (NULL, NULL) == NULL);
+    }
+
+    // action sets
+    {
+        zlist_t *actions1 = zlist_new ();
+        zlist_autofree (actions1);
+        zlist_append (actions1, (void *) ACTION_EMAIL);
+        zlist_append (actions1, (void *) ACTION_SMS);
+        zlist_t *actions2 = zlist_dup (actions1);
+        zlist_t *actions3 = zlist_new ();
+        zlist_autofree (actions3);
+        zlist_append (actions3, (void *) ACTION_SMS);
+        zlist_append (actions3, (void *) ACTION_EMAIL);
+        zlist_t *empty = zlist_new ();
+
+        const char *set = alert_intern_actions (actions1);
+        assert (set);
+        assert (alert_intern_actions (actions2) == set);
+        assert (alert_intern_actions (actions3) != set);
+        assert (alert_intern_actions (empty) == alert_intern_actions (NULL));
+        assert (alert_intern_actions (empty) != set);
+
+        // same set scanned from an encoded alert
+        zlist_t *copy = zlist_dup (actions1);
+        fty_proto_t *alert = alert_new ("intern.rule@ups-1", "ups-1", "ACTIVE", "WARNING",
+            "", 1, &copy, 0);
+        zmsg_t *msg = fty_proto_encode (&alert);
+        alert_frame_t frame;
+        if (alert_frame_probe () && alert_frame_scan (&frame, msg) == 0)
+            assert (alert_intern_actions_frame (&frame) == set);
+        zmsg_destroy (&msg);
+
+        zlist_destroy (&actions1);
+        zlist_destroy (&actions2);
+        zlist_destroy (&actions3);
+        zlist_destroy (&empty);
+    }
+
+    size_t size = alert_intern_size ();
+    alert_intern_string ("CRITICAL");
+    alert_intern_identity ("Intern.Rule@UPS-1", "UPS-1");
+    assert (alert_intern_size () == size);
+    if (verbose)
+        log_debug ("alert_intern: %zu values pooled", size);
+    //  @end
+
+    printf ("OK\n");
+}
@@ -0,0 +1,71 @@
+/*  =========================================================================
+    alert_intern - Interning pool for alert attributes
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#ifndef ALERT_INTERN_H_INCLUDED
+#define ALERT_INTERN_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Values returned by this class are shared, immutable and live until the
+// process exits; two values of the same kind are equal iff their pointers are.
+
+// canonical copy of 'string'
+// returns NULL if 'string' is NULL
+FTY_ALERT_LIST_EXPORT const char *
+    alert_intern_string (const char *string);
+
+// canonical identity of alert ('rule', 'element'), matching the same alerts
+// as alert_id_comparator () does
+// returns NULL if 'rule' or 'element' is NULL
+FTY_ALERT_LIST_EXPORT const char *
+    alert_intern_identity (const char *rule, const char *element);
+
+// like alert_intern_identity (), but never grows the pool
+// returns NULL if no such identity was interned yet
+FTY_ALERT_LIST_EXPORT const char *
+    alert_intern_identity_lookup (const char *rule, const char *element);
+
+// canonical action set of 'actions' (order matters, NULL is an empty set)
+FTY_ALERT_LIST_EXPORT const char *
+    alert_intern_actions (zlist_t *actions);
+
+// canonical action set of scanned alert 'frame', equal to alert_intern_actions ()
+// of the decoded action list
+FTY_ALERT_LIST_EXPORT const char *
+    alert_intern_actions_frame (const alert_frame_t *frame);
+
+// number of values held by the pool
+FTY_ALERT_LIST_EXPORT size_t
+    alert_intern_size (void);
+
+//  Self test of this class
+FTY_ALERT_LIST_EXPORT void
+    alert_intern_test (bool verbose);
+
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,514 @@
+/*  =========================================================================
+    alert_journal - Write-ahead journal of alert cache changes
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/*
+@header
+    alert_journal - Write-ahead journal of alert cache changes
+@discuss
+    Every change of a cached alert (new alert, state transition, acknowledge,
+    TTL cleanup) appends one record to <state_file>.journal, so that the
+    cost of durability follows the rate of changes, not the size of the
+    cache. Records are buffered and written and synced together by
+    alert_journal_commit ().
+
+    A record is the fty_proto encoding of the whole changed alert, prefixed
+    by its size and CRC-32C (both 4 bytes, network order). Replaying the
+    records in order on top of the state file therefore restores the cache,
+    whatever changes the snapshot has already seen.
+
+    Checkpoints fold the journal: alert_journal_rotate () sets the records
+    aside to <state_file>.journal.old before the snapshot is taken, and
+    alert_journal_folded () drops them once the snapshot is saved.
+@end
+*/
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "fty_alert_list_classes.h"
+
+#define JOURNAL_HEADER_SIZE     8       // size and CRC-32C of the record
+
+struct _alert_journal_t {
+    char *filename;             // path/state_file.journal
+    char *rotated;              // path/state_file.journal.old
+    int fd;
+    size_t size;                // bytes written to the journal
+    size_t rotated_size;        // bytes set aside by alert_journal_rotate ()
+    std::string buffer;         // records appended and not written yet
+    std::mutex mutex;           // guards buffer
+    std::mutex write_mutex;     // guards the files
+};
+
+static void
+s_put_number4 (char *needle, uint32_t value)
+{
+    needle [0] = (char) ((value >> 24) & 0xff);
+    needle [1] = (char) ((value >> 16) & 0xff);
+    needle [2] = (char) ((value >> 8) & 0xff);
+    needle [3] = (char) (value & 0xff);
+}
+
+static uint32_t
+s_number4 (const byte *needle)
+{
+    return ((uint32_t) needle [0] << 24) | ((uint32_t) needle [1] << 16)
+         | ((uint32_t) needle [2] << 8) | (uint32_t) needle [3];
+}
+
+// read whole file 'filename' into 'content'
+// returns false if it doesn't exist or can't be read
+static bool
+s_read_file (const char *filename, std::string &content)
+{
+    int fd = open (filename, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return false;
+    content.clear ();
+    char buffer [65536];
+    ssize_t rv;
+    while ((rv = read (fd, buffer, sizeof (buffer))) != 0) {
+        if (rv == -1) {
+            if (errno == EINTR)
+                continue;
+            close (fd);
+            return false;
+        }
+        content.append (buffer, (size_t) rv);
+    }
+    close (fd);
+    return true;
+}
+
+// size of the valid records at the start of 'data' of 'size' bytes, the
+// rest is a record torn by a crash; calls 'apply' on each record if given
+template <typename Apply> static size_t
+s_records (const byte *data, size_t size, Apply apply)
+{
+    size_t offset = 0;
+    while (size - offset >= JOURNAL_HEADER_SIZE) {
+        uint32_t length = s_number4 (data + offset);
+        uint32_t crc = s_number4 (data + offset + 4);
+        if (length > size - offset - JOURNAL_HEADER_SIZE)
+            break;
+        const byte *record = data + offset + JOURNAL_HEADER_SIZE;
+        if (alert_crc32c (0, record, length) != crc)
+            break;
+        apply (record, length);
+        offset += JOURNAL_HEADER_SIZE + length;
+    }
+    return offset;
+}
+
+// write all 'size' bytes of 'data' to 'fd'
+// 0 - success, -1 - error
+static int
+s_write_all (int fd, const char *data, size_t size)
+{
+    while (size) {
+        ssize_t rv = write (fd, data, size);
+        if (rv == -1) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        data += rv;
+        size -= (size_t) rv;
+    }
+    return 0;
+}
+
+// open journal file for appending, cutting off a torn record at its end
+// returns file descriptor, -1 on error
+static int
+s_open (const char *filename, size_t *size)
+{
+    std::string content;
+    bool exists = s_read_file (filename, content);
+    int fd = open (filename, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd == -1)
+        return -1;
+    *size = 0;
+    if (exists) {
+        *size = s_records ((const byte *) content.data (), content.size (),
+            [] (const byte *, size_t) {});
+        if (*size != content.size ()) {
+            log_warning ("%s: dropping %zu bytes of torn record", filename, content.size () - *size);
+            if (ftruncate (fd, (off_t) *size) == -1) {
+                close (fd);
+                return -1;
+            }
+        }
+    }
+    return fd;
+}
+
+alert_journal_t *
+alert_journal_new (const char *path, const char *filename)
+{
+    assert (path);
+    assert (filename);
+    alert_journal_t *self = new (std::nothrow) alert_journal_t;
+    if (!self)
+        return NULL;
+    self->filename = zsys_sprintf ("%s/%s%s", path, filename, JOURNAL_SUFFIX);
+    self->rotated = zsys_sprintf ("%s/%s%s", path, filename, JOURNAL_ROTATED_SUFFIX);
+    self->rotated_size = 0;
+    self->fd = (self->filename && self->rotated) ? s_open (self->filename, &self->size) : -1;
+    if (self->fd == -1) {
+        log_error ("cannot open journal %s", self->filename ? self->filename : filename);
+        zstr_free (&self->filename);
+        zstr_free (&self->rotated);
+        delete self;
+        return NULL;
+    }
+    struct stat rotated;
+    if (stat (self->rotated, &rotated) == 0)
+        self->rotated_size = (size_t) rotated.st_size;
+    return self;
+}
+
+void
+alert_journal_destroy (alert_journal_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        alert_journal_t *self = *self_p;
+        alert_journal_commit (self);
+        close (self->fd);
+        zstr_free (&self->filename);
+        zstr_free (&self->rotated);
+        delete self;
+        *self_p = NULL;
+    }
+}
+
+int
+alert_journal_append (alert_journal_t *self, fty_proto_t *alert)
+{
+    assert (self);
+    assert (alert);
+    fty_proto_t *copy = fty_proto_dup (alert);
+    zmsg_t *encoded = copy ? fty_proto_encode (&copy) : NULL;
+    zframe_t *frame = encoded ? zmsg_first (encoded) : NULL;
+    if (!frame) {
+        log_error ("cannot encode journal record of %s", fty_proto_rule (alert));
+        zmsg_destroy (&encoded);
+        return -1;
+    }
+
+    char header [JOURNAL_HEADER_SIZE];
+    s_put_number4 (header, (uint32_t) zframe_size (frame));
+    s_put_number4 (header + 4, alert_crc32c (0, zframe_data (frame), zframe_size (frame)));
+    {
+        std::lock_guard<std::mutex> lock (self->mutex);
+        self->buffer.append (header, sizeof (header));
+        self->buffer.append ((const char *) zframe_data (frame), zframe_size (frame));
+    }
+    zmsg_destroy (&encoded);
+    alert_stats_add (ALERT_STATS_JOURNAL_RECORDS, 1);
+    return 0;
+}
+
+int
+alert_journal_commit (alert_journal_t *self)
+{
+    assert (self);
+    std::lock_guard<std::mutex> write_lock (self->write_mutex);
+    std::string records;
+    {
+        std::lock_guard<std::mutex> lock (self->mutex);
+        records.swap (self->buffer);
+    }
+    if (records.empty ())
+        return 0;
+
+    if (s_write_all (self->fd, records.data (), records.size ()) == -1 || fdatasync (self->fd) == -1) {
+        log_error ("cannot write journal %s: %s", self->filename, strerror (errno));
+        // drop what was written of the group, retry it with the next commit
+        if (ftruncate (self->fd, (off_t) self->size) == -1)
+            log_error ("cannot truncate journal %s: %s", self->filename, strerror (errno));
+        std::lock_guard<std::mutex> lock (self->mutex);
+        self->buffer.insert (0, records);
+        return -1;
+    }
+    self->size += records.size ();
+    alert_stats_add (ALERT_STATS_JOURNAL_COMMITS, 1);
+    return 0;
+}
+
+size_t
+alert_journal_pending (alert_journal_t *self)
+{
+    assert (self);
+    std::lock_guard<std::mutex> lock (self->mutex);
+    return self->buffer.size ();
+}
+
+size_t
+alert_journal_size (alert_journal_t *self)
+{
+    assert (self);
+    std::lock_guard<std::mutex> write_lock (self->write_mutex);
+    return self->size + self->rotated_size;
+}
+
+int
+alert_journal_rotate (alert_journal_t *self)
+{
+    assert (self);
+    std::lock_guard<std::mutex> write_lock (self->write_mutex);
+    // records not set aside are replayed after the snapshot, which is fine:
+    // each one is followed by all later changes of the same alert
+    if (self->rotated_size || self->size == 0)
+        return 0;
+
+    if (rename (self->filename, self->rotated) == -1) {
+        log_error ("cannot rotate journal %s: %s", self->filename, strerror (errno));
+        return -1;
+    }
+    close (self->fd);
+    self->rotated_size = self->size;
+    self->fd = s_open (self->filename, &self->size);
+    if (self->fd == -1) {
+        log_error ("cannot open journal %s: %s", self->filename, strerror (errno));
+        // keep appending to the rotated one
+        rename (self->rotated, self->filename);
+        self->fd = s_open (self->filename, &self->size);
+        self->rotated_size = 0;
+        return -1;
+    }
+    return 0;
+}
+
+void
+alert_journal_folded (alert_journal_t *self)
+{
+    assert (self);
+    std::lock_guard<std::mutex> write_lock (self->write_mutex);
+    if (unlink (self->rotated) == -1 && errno != ENOENT)
+        log_error ("cannot remove journal %s: %s", self->rotated, strerror (errno));
+    self->rotated_size = 0;
+}
+
+// make 'target' equal to 'source', taking over its aux and actions
+static void
+s_alert_assign (fty_proto_t *target, fty_proto_t *source)
+{
+    fty_proto_set_time (target, fty_proto_time (source));
+    fty_proto_set_ttl (target, fty_proto_ttl (source));
+    fty_proto_set_rule (target, "%s", fty_proto_rule (source));
+    fty_proto_set_name (target, "%s", fty_proto_name (source));
+    fty_proto_set_state (target, "%s", fty_proto_state (source));
+    fty_proto_set_severity (target, "%s", fty_proto_severity (source));
+    fty_proto_set_description (target, "%s", fty_proto_description (source));
+    fty_proto_set_metadata (target, "%s", fty_proto_metadata (source));
+    zhash_t *aux = fty_proto_get_aux (source);
+    fty_proto_set_aux (target, &aux);
+    zlist_t *actions = fty_proto_get_action (source);
+    fty_proto_set_action (target, &actions);
+}
+
+int
+alert_journal_replay (zlistx_t *alerts, const char *path, const char *filename)
+{
+    if (!alerts || !path || !filename)
+        return -1;
+
+    // cached alerts by identity
+    std::unordered_map<const char *, void *> handles;
+    fty_proto_t *cursor = (fty_proto_t *) zlistx_first (alerts);
+    while (cursor) {
+        const char *identity = alert_intern_identity (fty_proto_rule (cursor), fty_proto_name (cursor));
+        if (identity)
+            handles [identity] = zlistx_cursor (alerts);
+        cursor = (fty_proto_t *) zlistx_next (alerts);
+    }
+
+    int applied = 0;
+    const char *suffixes [] = { JOURNAL_ROTATED_SUFFIX, JOURNAL_SUFFIX };
+    for (const char *suffix : suffixes) {
+        char *journal = zsys_sprintf ("%s/%s%s", path, filename, suffix);
+        std::string content;
+        if (!journal || !s_read_file (journal, content)) {
+            zstr_free (&journal);
+            continue;
+        }
+
+        size_t valid = s_records ((const byte *) content.data (), content.size (),
+            [&] (const byte *record, size_t size) {
+                zmsg_t *msg = zmsg_new ();
+                zmsg_addmem (msg, record, size);
+                fty_proto_t *alert = fty_proto_decode (&msg);
+                const char *identity = (alert && fty_proto_id (alert) == FTY_PROTO_ALERT) ?
+                    alert_intern_identity (fty_proto_rule (alert), fty_proto_name (alert)) : NULL;
+                if (!identity) {
+                    log_warning ("%s: ignoring malformed record", journal);
+                    fty_proto_destroy (&alert);
+                    return;
+                }
+                auto it = handles.find (identity);
+                if (it != handles.end ()) {
+                    s_alert_assign ((fty_proto_t *) zlistx_handle_item (it->second), alert);
+                    fty_proto_destroy (&alert);
+                }
+                else {
+                    void *handle = zlistx_add_end (alerts, alert);
+                    // list with a duplicator keeps its own copy
+                    if (zlistx_handle_item (handle) != alert)
+                        fty_proto_destroy (&alert);
+                    handles [identity] = handle;
+                }
+                applied++;
+            });
+        if (valid != content.size ())
+            log_warning ("%s: ignoring %zu bytes of torn record", journal, content.size () - valid);
+        log_debug ("%s: %zu bytes replayed", journal, valid);
+        zstr_free (&journal);
+    }
+    return applied;
+}
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+alert_journal_test (bool verbose)
+{
+    printf (" * alert_journal: ");
+
+    //  @selftest
+    const char *path = ".";
+    const char *filename = "test_journal_state";
+    zsys_file_delete ("./test_journal_state.journal");
+    zsys_file_delete ("./test_journal_state.journal.old");
+
+    // no journal, nothing to replay
+    {
+        zlistx_t *alerts = zlistx_new ();
+        assert (alert_journal_replay (alerts, path, filename) == 0);
+        assert (alert_journal_replay (alerts, NULL, filename) == -1);
+        zlistx_destroy (&alerts);
+    }
+
+    alert_journal_t *journal = alert_journal_new (path, filename);
+    assert (journal);
+    assert (alert_journal_size (journal) == 0);
+
+    zlist_t *actions1 = zlist_new ();
+    zlist_autofree (actions1);
+    zlist_append (actions1, (void *) "EMAIL");
+    zlist_t *actions2 = zlist_new ();
+    zlist_autofree (actions2);
+    fty_proto_t *alert1 = alert_new ("Rule1", "Element1", "ACTIVE", "CRITICAL", "description", 1, &actions1, 0);
+    fty_proto_t *alert2 = alert_new ("Rule2", "Element2", "ACTIVE", "WARNING", "description", 2, &actions2, 0);
+    assert (alert_journal_append (journal, alert1) == 0);
+    assert (alert_journal_append (journal, alert2) == 0);
+    assert (alert_journal_pending (journal) > 0);
+    assert (alert_journal_commit (journal) == 0);
+    assert (alert_journal_pending (journal) == 0);
+    fty_proto_set_state (alert1, "%s", "RESOLVED");
+    fty_proto_set_time (alert1, 3);
+    assert (alert_journal_append (journal, alert1) == 0);
+    assert (alert_journal_commit (journal) == 0);
+    assert (alert_journal_commit (journal) == 0);
+    assert (alert_journal_size (journal) > 0);
+
+    // replay adds and replaces alerts, in order
+    {
+        zlistx_t *alerts = zlistx_new ();
+        zlistx_set_destructor (alerts, (czmq_destructor *) fty_proto_destroy);
+        zlistx_set_duplicator (alerts, (czmq_duplicator *) fty_proto_dup);
+        zlistx_add_end (alerts, alert2);
+        assert (alert_journal_replay (alerts, path, filename) == 3);
+        assert (zlistx_size (alerts) == 2);
+        fty_proto_t *replayed = (fty_proto_t *) zlistx_first (alerts);
+        assert (alert_comparator (replayed, alert2) == 0);
+        replayed = (fty_proto_t *) zlistx_next (alerts);
+        assert (alert_comparator (replayed, alert1) == 0);
+        assert (streq (fty_proto_state (replayed), "RESOLVED"));
+        zlistx_destroy (&alerts);
+    }
+
+    // rotated records are replayed until folded
+    assert (alert_journal_rotate (journal) == 0);
+    fty_proto_set_state (alert2, "%s", "ACK-WIP");
+    assert (alert_journal_append (journal, alert2) == 0);
+    assert (alert_journal_commit (journal) == 0);
+    {
+        zlistx_t *alerts = zlistx_new ();
+        zlistx_set_destructor (alerts, (czmq_destructor *) fty_proto_destroy);
+        assert (alert_journal_replay (alerts, path, filename) == 4);
+        assert (zlistx_size (alerts) == 2);
+        zlistx_destroy (&alerts);
+    }
+    alert_journal_folded (journal);
+    {
+        zlistx_t *alerts = zlistx_new ();
+        zlistx_set_destructor (alerts, (czmq_destructor *) fty_proto_destroy);
+        assert (alert_journal_replay (alerts, path, filename) == 1);
+        assert (zlistx_size (alerts) == 1);
+        assert (streq (fty_proto_state ((fty_proto_t *) zlistx_first (alerts)), "ACK-WIP"));
+        zlistx_destroy (&alerts);
+    }
+    alert_journal_destroy (&journal);
+    assert (journal == NULL);
+    alert_journal_destroy (&journal);
+
+    // torn record is cut off when the journal is opened again
+    {
+        FILE *file = fopen ("./test_journal_state.journal", "ab");
+        assert (file);
+        fwrite ("\x00\x00\x01\x00garbage", 1, 11, file);
+        fclose (file);
+
+        zlistx_t *alerts = zlistx_new ();
+        zlistx_set_destructor (alerts, (czmq_destructor *) fty_proto_destroy);
+        assert (alert_journal_replay (alerts, path, filename) == 1);
+        zlistx_destroy (&alerts);
+
+        journal = alert_journal_new (path, filename);
+        assert (journal);
+        assert (alert_journal_append (journal, alert1) == 0);
+        alert_journal_destroy (&journal);
+
+        alerts = zlistx_new ();
+        zlistx_set_destructor (alerts, (czmq_destructor *) fty_proto_destroy);
+        assert (alert_journal_replay (alerts, path, filename) == 2);
+        assert (zlistx_size (alerts) == 2);
+        zlistx_destroy (&alerts);
+    }
+
+    if (verbose)
+        log_debug ("alert_journal: %" PRIi64 " records in %" PRIi64 " commits",
+            alert_stats_get (ALERT_STATS_JOURNAL_RECORDS), alert_stats_get (ALERT_STATS_JOURNAL_COMMITS));
+
+    fty_proto_destroy (&alert1);
+    fty_proto_destroy (&alert2);
+    zsys_file_delete ("./test_journal_state.journal");
+    zsys_file_delete ("./test_journal_state.journal.old");
+    //  @end
+
+    printf ("OK\n");
+}
@@ -0,0 +1,92 @@
+/*  =========================================================================
+    alert_journal - Write-ahead journal of alert cache changes
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#ifndef ALERT_JOURNAL_H_INCLUDED
+#define ALERT_JOURNAL_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// journal of state file 'filename' is 'filename' JOURNAL_SUFFIX, its part
+// being folded into the state file 'filename' JOURNAL_ROTATED_SUFFIX
+#define JOURNAL_SUFFIX          ".journal"
+#define JOURNAL_ROTATED_SUFFIX  ".journal.old"
+
+// open journal of state file 'filename' in 'path' for appending
+// returns new journal, NULL if it can't be opened
+FTY_ALERT_LIST_EXPORT alert_journal_t *
+    alert_journal_new (const char *path, const char *filename);
+
+// commit pending records and close the journal
+FTY_ALERT_LIST_EXPORT void
+    alert_journal_destroy (alert_journal_t **self_p);
+
+// append record of the current content of cached 'alert' (thread safe);
+// the record is durable after next alert_journal_commit ()
+// 0 - success, -1 - error
+FTY_ALERT_LIST_EXPORT int
+    alert_journal_append (alert_journal_t *self, fty_proto_t *alert);
+
+// write all appended records and sync them to disk, at once (thread safe)
+// 0 - success, -1 - error
+FTY_ALERT_LIST_EXPORT int
+    alert_journal_commit (alert_journal_t *self);
+
+// bytes appended and not committed yet
+FTY_ALERT_LIST_EXPORT size_t
+    alert_journal_pending (alert_journal_t *self);
+
+// bytes of the journal on disk, including a rotated part not folded yet
+FTY_ALERT_LIST_EXPORT size_t
+    alert_journal_size (alert_journal_t *self);
+
+// start folding the journal into a snapshot of the state: records appended
+// so far are set aside, new ones go to an empty journal. The snapshot must
+// be taken after this call. If a previous fold didn't complete, records
+// keep going to the current journal.
+// 0 - success, -1 - error
+FTY_ALERT_LIST_EXPORT int
+    alert_journal_rotate (alert_journal_t *self);
+
+// snapshot taken after alert_journal_rotate () was saved, drop the records
+// set aside
+FTY_ALERT_LIST_EXPORT void
+    alert_journal_folded (alert_journal_t *self);
+
+// apply journal of state file 'filename' in 'path' on 'alerts' loaded from
+// the state file, in order: alerts are replaced or added by identity.
+// A torn record at the end (crash in the middle of a write) ends the replay.
+// returns number of records applied, -1 on error
+FTY_ALERT_LIST_EXPORT int
+    alert_journal_replay (zlistx_t *alerts, const char *path, const char *filename);
+
+//  Self test of this class
+FTY_ALERT_LIST_EXPORT void
+    alert_journal_test (bool verbose);
+
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
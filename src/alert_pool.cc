@@ -0,0 +1,319 @@
+/*  =========================================================================
+    alert_pool - Slab pool and bump arena allocators
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/*
+@header
+    alert_pool - Slab pool and bump arena allocators
+@discuss
+    The agent runs for months. Bookkeeping of the alert cache is allocated
+    from slab pools, so that entries of the same size live next to each other
+    and freed entries are reused instead of fragmenting the heap.
+
+    Short lived data of a single request (lookup keys and the like) go to a
+    bump arena, which is released at once when the request is done.
+@end
+*/
+
+#include <mutex>
+#include <vector>
+#include <unordered_map>
+#include "fty_alert_list_classes.h"
+
+#define POOL_ALIGN(size) (((size) + sizeof (void *) - 1) & ~(sizeof (void *) - 1))
+
+struct _alert_pool_t {
+    size_t block_size;
+    size_t blocks_per_slab;
+    void *free_list;            // free blocks, linked through their first word
+    std::vector<void *> slabs;
+    size_t used;
+    std::mutex mutex;
+};
+
+typedef struct _arena_chunk_t {
+    struct _arena_chunk_t *next;
+    size_t size;                // usable bytes following the header
+} arena_chunk_t;
+
+#define CHUNK_DATA(chunk) ((char *) (chunk) + POOL_ALIGN (sizeof (arena_chunk_t)))
+
+struct _alert_arena_t {
+    size_t chunk_size;
+    arena_chunk_t *chunks;      // current chunk first, the first allocated last
+    size_t used;                // bytes used in the current chunk
+    size_t size;                // bytes allocated since the last reset
+};
+
+alert_pool_t *
+alert_pool_new (size_t block_size, size_t blocks_per_slab)
+{
+    alert_pool_t *self = new (std::nothrow) alert_pool_t;
+    if (!self)
+        return NULL;
+    self->block_size = POOL_ALIGN (block_size < sizeof (void *) ? sizeof (void *) : block_size);
+    self->blocks_per_slab = blocks_per_slab ? blocks_per_slab : 1;
+    self->free_list = NULL;
+    self->used = 0;
+    return self;
+}
+
+void
+alert_pool_destroy (alert_pool_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        alert_pool_t *self = *self_p;
+        for (void *slab : self->slabs)
+            free (slab);
+        delete self;
+        *self_p = NULL;
+    }
+}
+
+void *
+alert_pool_alloc (alert_pool_t *self)
+{
+    assert (self);
+    std::lock_guard<std::mutex> lock (self->mutex);
+
+    if (!self->free_list) {
+        char *slab = (char *) malloc (self->block_size * self->blocks_per_slab);
+        if (!slab)
+            return NULL;
+        self->slabs.push_back (slab);
+        // thread the blocks of the new slab, first block on top
+        for (size_t i = self->blocks_per_slab; i > 0; i--) {
+            void *block = slab + (i - 1) * self->block_size;
+            *(void **) block = self->free_list;
+            self->free_list = block;
+        }
+        alert_stats_add (ALERT_STATS_POOL_SLABS, 1);
+    }
+
+    void *block = self->free_list;
+    self->free_list = *(void **) block;
+    self->used++;
+    alert_stats_add (ALERT_STATS_POOL_ALLOCS, 1);
+    return block;
+}
+
+void
+alert_pool_free (alert_pool_t *self, void *block)
+{
+    assert (self);
+    if (!block)
+        return;
+    std::lock_guard<std::mutex> lock (self->mutex);
+    *(void **) block = self->free_list;
+    self->free_list = block;
+    self->used--;
+    alert_stats_add (ALERT_STATS_POOL_FREES, 1);
+}
+
+size_t
+alert_pool_used (alert_pool_t *self)
+{
+    assert (self);
+    std::lock_guard<std::mutex> lock (self->mutex);
+    return self->used;
+}
+
+size_t
+alert_pool_slabs (alert_pool_t *self)
+{
+    assert (self);
+    std::lock_guard<std::mutex> lock (self->mutex);
+    return self->slabs.size ();
+}
+
+alert_arena_t *
+alert_arena_new (size_t chunk_size)
+{
+    alert_arena_t *self = (alert_arena_t *) zmalloc (sizeof (alert_arena_t));
+    if (!self)
+        return NULL;
+    self->chunk_size = chunk_size ? chunk_size : 4096;
+    return self;
+}
+
+void
+alert_arena_destroy (alert_arena_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        alert_arena_t *self = *self_p;
+        while (self->chunks) {
+            arena_chunk_t *next = self->chunks->next;
+            free (self->chunks);
+            self->chunks = next;
+        }
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+void *
+alert_arena_alloc (alert_arena_t *self, size_t size)
+{
+    assert (self);
+    size = POOL_ALIGN (size ? size : 1);
+
+    if (!self->chunks || self->used + size > self->chunks->size) {
+        size_t chunk_size = size > self->chunk_size ? size : self->chunk_size;
+        arena_chunk_t *chunk = (arena_chunk_t *) malloc (POOL_ALIGN (sizeof (arena_chunk_t)) + chunk_size);
+        if (!chunk)
+            return NULL;
+        chunk->size = chunk_size;
+        chunk->next = self->chunks;
+        self->chunks = chunk;
+        self->used = 0;
+        alert_stats_add (ALERT_STATS_ARENA_CHUNKS, 1);
+    }
+
+    void *data = CHUNK_DATA (self->chunks) + self->used;
+    self->used += size;
+    self->size += size;
+    alert_stats_add (ALERT_STATS_ARENA_ALLOCS, 1);
+    return data;
+}
+
+char *
+alert_arena_strdup (alert_arena_t *self, const char *string)
+{
+    assert (self);
+    if (!string)
+        return NULL;
+    size_t length = strlen (string);
+    char *copy = (char *) alert_arena_alloc (self, length + 1);
+    if (copy)
+        memcpy (copy, string, length + 1);
+    return copy;
+}
+
+void
+alert_arena_reset (alert_arena_t *self)
+{
+    assert (self);
+    while (self->chunks && self->chunks->next) {
+        arena_chunk_t *next = self->chunks->next;
+        free (self->chunks);
+        self->chunks = next;
+    }
+    self->used = 0;
+    self->size = 0;
+}
+
+size_t
+alert_arena_size (alert_arena_t *self)
+{
+    assert (self);
+    return self->size;
+}
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+alert_pool_test (bool verbose)
+{
+    printf (" * alert_pool: ");
+
+    //  @selftest
+    // slab pool
+    {
+        alert_pool_t *pool = alert_pool_new (24, 4);
+        assert (pool);
+        void *blocks [10];
+        for (int i = 0; i < 10; i++) {
+            blocks [i] = alert_pool_alloc (pool);
+            assert (blocks [i]);
+            assert (((uintptr_t) blocks [i] % sizeof (void *)) == 0);
+            memset (blocks [i], i, 24);
+        }
+        assert (alert_pool_used (pool) == 10);
+        assert (alert_pool_slabs (pool) == 3);
+        for (int i = 0; i < 10; i++)
+            for (int j = i + 1; j < 10; j++)
+                assert (blocks [i] != blocks [j]);
+
+        // freed blocks are reused before a new slab is allocated
+        alert_pool_free (pool, blocks [3]);
+        alert_pool_free (pool, blocks [7]);
+        alert_pool_free (pool, NULL);
+        assert (alert_pool_used (pool) == 8);
+        void *again = alert_pool_alloc (pool);
+        assert (again == blocks [7]);
+        blocks [7] = again;
+        blocks [3] = alert_pool_alloc (pool);
+        assert (alert_pool_slabs (pool) == 3);
+        for (int i = 0; i < 10; i++)
+            alert_pool_free (pool, blocks [i]);
+        assert (alert_pool_used (pool) == 0);
+        alert_pool_destroy (&pool);
+        assert (pool == NULL);
+        alert_pool_destroy (&pool);
+    }
+
+    // allocator of std containers
+    {
+        std::unordered_map<int, std::string, std::hash<int>, std::equal_to<int>,
+            alert_pool_allocator<std::pair<const int, std::string>>> map;
+        for (int i = 0; i < 1000; i++)
+            map [i] = std::to_string (i);
+        for (int i = 0; i < 1000; i += 2)
+            map.erase (i);
+        assert (map.size () == 500);
+        assert (map [999] == "999");
+    }
+
+    // bump arena
+    {
+        alert_arena_t *arena = alert_arena_new (64);
+        assert (arena);
+        char *one = alert_arena_strdup (arena, "one");
+        char *two = alert_arena_strdup (arena, "two");
+        assert (streq (one, "one"));
+        assert (streq (two, "two"));
+        assert (two - one == (ptrdiff_t) sizeof (void *));
+        assert (alert_arena_strdup (arena, NULL) == NULL);
+
+        // bigger than a chunk
+        char *big = (char *) alert_arena_alloc (arena, 1000);
+        assert (big);
+        memset (big, 'x', 1000);
+        assert (streq (one, "one"));
+        assert (alert_arena_size (arena) == 2 * sizeof (void *) + 1000);
+
+        // reset keeps the first chunk
+        alert_arena_reset (arena);
+        assert (alert_arena_size (arena) == 0);
+        assert (alert_arena_strdup (arena, "three") == one);
+        alert_arena_destroy (&arena);
+        assert (arena == NULL);
+    }
+
+    if (verbose)
+        log_debug ("alert_pool: %" PRIi64 " pool allocations, %" PRIi64 " arena allocations",
+            alert_stats_get (ALERT_STATS_POOL_ALLOCS), alert_stats_get (ALERT_STATS_ARENA_ALLOCS));
+    //  @end
+
+    printf ("OK\n");
+}
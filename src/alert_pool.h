@@ -0,0 +1,140 @@
+/*  =========================================================================
+    alert_pool - Slab pool and bump arena allocators
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#ifndef ALERT_POOL_H_INCLUDED
+#define ALERT_POOL_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _alert_arena_t alert_arena_t;
+
+// create pool of blocks of 'block_size' bytes, carved from slabs of
+// 'blocks_per_slab' blocks; blocks are aligned to the size of a pointer
+FTY_ALERT_LIST_EXPORT alert_pool_t *
+    alert_pool_new (size_t block_size, size_t blocks_per_slab);
+
+// destroy the pool and all its slabs
+FTY_ALERT_LIST_EXPORT void
+    alert_pool_destroy (alert_pool_t **self_p);
+
+// get a block from the pool (thread safe)
+// returns NULL if out of memory
+FTY_ALERT_LIST_EXPORT void *
+    alert_pool_alloc (alert_pool_t *self);
+
+// give 'block' back to the pool (thread safe)
+FTY_ALERT_LIST_EXPORT void
+    alert_pool_free (alert_pool_t *self, void *block);
+
+// number of blocks currently in use
+FTY_ALERT_LIST_EXPORT size_t
+    alert_pool_used (alert_pool_t *self);
+
+// number of slabs allocated by the pool
+FTY_ALERT_LIST_EXPORT size_t
+    alert_pool_slabs (alert_pool_t *self);
+
+// create arena allocating from chunks of 'chunk_size' bytes; the arena is
+// not thread safe, each user owns its own
+FTY_ALERT_LIST_EXPORT alert_arena_t *
+    alert_arena_new (size_t chunk_size);
+
+// destroy the arena and all memory allocated from it
+FTY_ALERT_LIST_EXPORT void
+    alert_arena_destroy (alert_arena_t **self_p);
+
+// allocate 'size' bytes aligned to the size of a pointer
+// returns NULL if out of memory
+FTY_ALERT_LIST_EXPORT void *
+    alert_arena_alloc (alert_arena_t *self, size_t size);
+
+// copy of 'string' allocated from the arena
+// returns NULL if 'string' is NULL or out of memory
+FTY_ALERT_LIST_EXPORT char *
+    alert_arena_strdup (alert_arena_t *self, const char *string);
+
+// release everything allocated from the arena at once; the first chunk is
+// kept for reuse, the others go back to the heap
+FTY_ALERT_LIST_EXPORT void
+    alert_arena_reset (alert_arena_t *self);
+
+// number of bytes allocated from the arena since the last reset
+FTY_ALERT_LIST_EXPORT size_t
+    alert_arena_size (alert_arena_t *self);
+
+//  Self test of this class
+FTY_ALERT_LIST_EXPORT void
+    alert_pool_test (bool verbose);
+
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#ifdef __cplusplus
+#include <new>
+
+// Allocator of node based std containers: single objects (the nodes) come
+// from a slab pool shared by all allocators of the same type, arrays (bucket
+// tables) from the heap. The pool is never destroyed.
+template <typename T>
+struct alert_pool_allocator {
+    typedef T value_type;
+    template <typename U> struct rebind { typedef alert_pool_allocator<U> other; };
+
+    alert_pool_allocator () {}
+    template <typename U> alert_pool_allocator (const alert_pool_allocator<U> &) {}
+
+    T *
+    allocate (size_t n) {
+        void *block = (n == 1) ? alert_pool_alloc (pool ()) : malloc (n * sizeof (T));
+        if (!block)
+            throw std::bad_alloc ();
+        return static_cast<T *> (block);
+    }
+
+    void
+    deallocate (T *block, size_t n) {
+        if (n == 1)
+            alert_pool_free (pool (), block);
+        else
+            free (block);
+    }
+
+    static alert_pool_t *
+    pool () {
+        static_assert (alignof (T) <= sizeof (void *), "alert_pool_t blocks are aligned to pointer size");
+        static alert_pool_t *pool = alert_pool_new (sizeof (T), 256);
+        return pool;
+    }
+};
+
+template <typename T, typename U> bool
+operator== (const alert_pool_allocator<T> &, const alert_pool_allocator<U> &) { return true; }
+
+template <typename T, typename U> bool
+operator!= (const alert_pool_allocator<T> &, const alert_pool_allocator<U> &) { return false; }
+#endif
+
+#endif
@@ -0,0 +1,168 @@
+/*  =========================================================================
+    alert_stats - Counters and memory usage of the agent
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/*
+@header
+    alert_stats - Counters and memory usage of the agent
+@discuss
+    Process wide counters, updated lock-free from any actor. The stream actor
+    logs them on STATS command, together with the resident set size, so that
+    heap growth of a long running agent can be followed in the journal.
+@end
+*/
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unistd.h>
+#include "fty_alert_list_classes.h"
+
+// names of counters, indexed by alert_stats_counter_t
+static const char *s_names [ALERT_STATS_COUNT] = {
+    "received",
+    "published",
+    "list_requests",
+    "ack_requests",
+    "decode_skipped",
+    "refreshed",
+    "flapping",
+    "damped",
+    "keepalives",
+    "announced",
+    "checkpoints",
+    "journal_records",
+    "journal_commits",
+    "materialized",
+    "pool_allocs",
+    "pool_frees",
+    "pool_slabs",
+    "arena_allocs",
+    "arena_chunks"
+};
+
+static std::atomic<int64_t> s_counters [ALERT_STATS_COUNT];
+static std::atomic<size_t> s_rss_start (0);
+
+// counters at the previous alert_stats_log (), for rates
+static std::mutex s_log_mtx;
+static int64_t s_logged [ALERT_STATS_COUNT];
+static int64_t s_logged_at = 0;
+
+void
+alert_stats_add (alert_stats_counter_t counter, int64_t delta)
+{
+    if (counter < 0 || counter >= ALERT_STATS_COUNT)
+        return;
+    s_counters [counter].fetch_add (delta, std::memory_order_relaxed);
+}
+
+int64_t
+alert_stats_get (alert_stats_counter_t counter)
+{
+    if (counter < 0 || counter >= ALERT_STATS_COUNT)
+        return 0;
+    return s_counters [counter].load (std::memory_order_relaxed);
+}
+
+const char *
+alert_stats_name (alert_stats_counter_t counter)
+{
+    if (counter < 0 || counter >= ALERT_STATS_COUNT)
+        return NULL;
+    return s_names [counter];
+}
+
+size_t
+alert_stats_rss (void)
+{
+    // second field of statm is resident set size in pages
+    FILE *file = fopen ("/proc/self/statm", "r");
+    if (!file)
+        return 0;
+    unsigned long size = 0, resident = 0;
+    int rv = fscanf (file, "%lu %lu", &size, &resident);
+    fclose (file);
+    if (rv != 2)
+        return 0;
+    return (size_t) resident * (size_t) sysconf (_SC_PAGESIZE);
+}
+
+void
+alert_stats_log (void)
+{
+    size_t rss = alert_stats_rss ();
+    size_t start = 0;
+    if (s_rss_start.compare_exchange_strong (start, rss))
+        start = rss;
+
+    std::lock_guard<std::mutex> lock (s_log_mtx);
+    int64_t now = zclock_mono ();
+    int64_t elapsed = s_logged_at ? now - s_logged_at : 0;
+
+    std::string line;
+    for (int i = 0; i < ALERT_STATS_COUNT; i++) {
+        int64_t value = alert_stats_get ((alert_stats_counter_t) i);
+        line += " ";
+        line += s_names [i];
+        line += "=";
+        line += std::to_string (value);
+        if (elapsed > 0) {
+            char rate [32];
+            snprintf (rate, sizeof (rate), "(%.2f/s)", (double) (value - s_logged [i]) * 1000 / elapsed);
+            line += rate;
+        }
+        s_logged [i] = value;
+    }
+    s_logged_at = now;
+    log_info ("stats:%s rss=%zu rss_growth=%" PRIi64,
+        line.c_str (), rss, (int64_t) rss - (int64_t) start);
+}
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+alert_stats_test (bool verbose)
+{
+    printf (" * alert_stats: ");
+
+    //  @selftest
+    for (int i = 0; i < ALERT_STATS_COUNT; i++)
+        assert (alert_stats_name ((alert_stats_counter_t) i));
+    assert (alert_stats_name (ALERT_STATS_COUNT) == NULL);
+
+    int64_t received = alert_stats_get (ALERT_STATS_RECEIVED);
+    alert_stats_add (ALERT_STATS_RECEIVED, 1);
+    alert_stats_add (ALERT_STATS_RECEIVED, 2);
+    assert (alert_stats_get (ALERT_STATS_RECEIVED) == received + 3);
+    alert_stats_add (ALERT_STATS_RECEIVED, -3);
+    assert (alert_stats_get (ALERT_STATS_RECEIVED) == received);
+    // out of range counters are ignored
+    alert_stats_add (ALERT_STATS_COUNT, 1);
+    assert (alert_stats_get (ALERT_STATS_COUNT) == 0);
+
+    assert (alert_stats_rss () > 0);
+    alert_stats_log ();
+    alert_stats_log ();
+    //  @end
+
+    printf ("OK\n");
+}
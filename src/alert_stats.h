@@ -0,0 +1,85 @@
+/*  =========================================================================
+    alert_stats - Counters and memory usage of the agent
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#ifndef ALERT_STATS_H_INCLUDED
+#define ALERT_STATS_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// counters of the agent, see alert_stats_name () for their names
+typedef enum {
+    ALERT_STATS_RECEIVED = 0,       // alerts received on _ALERTS_SYS
+    ALERT_STATS_PUBLISHED,          // alerts published on ALERTS
+    ALERT_STATS_LIST_REQUESTS,      // rfc-alerts-list requests
+    ALERT_STATS_ACK_REQUESTS,       // rfc-alerts-acknowledge requests
+    ALERT_STATS_DECODE_SKIPPED,     // received alerts handled without decoding
+    ALERT_STATS_REFRESHED,          // same-severity ACTIVE re-evaluations of ACTIVE alerts
+    ALERT_STATS_FLAPPING,           // alerts found flapping and damped
+    ALERT_STATS_DAMPED,             // publishes held down for damped alerts
+    ALERT_STATS_KEEPALIVES,         // scheduled keep-alive publishes of ACTIVE alerts
+    ALERT_STATS_ANNOUNCED,          // alerts re-announced on ANNOUNCE command
+    ALERT_STATS_CHECKPOINTS,        // background checkpoints of the cache
+    ALERT_STATS_JOURNAL_RECORDS,    // records appended to the journal
+    ALERT_STATS_JOURNAL_COMMITS,    // group commits of the journal
+    ALERT_STATS_MATERIALIZED,       // RESOLVED alerts decoded from the state image after startup
+    ALERT_STATS_POOL_ALLOCS,        // blocks taken from slab pools
+    ALERT_STATS_POOL_FREES,         // blocks returned to slab pools
+    ALERT_STATS_POOL_SLABS,         // slabs allocated by slab pools
+    ALERT_STATS_ARENA_ALLOCS,       // allocations from bump arenas
+    ALERT_STATS_ARENA_CHUNKS,       // chunks allocated by bump arenas
+    ALERT_STATS_COUNT
+} alert_stats_counter_t;
+
+// add 'delta' to 'counter' (thread safe)
+FTY_ALERT_LIST_EXPORT void
+    alert_stats_add (alert_stats_counter_t counter, int64_t delta);
+
+// current value of 'counter'
+FTY_ALERT_LIST_EXPORT int64_t
+    alert_stats_get (alert_stats_counter_t counter);
+
+// name of 'counter', NULL if out of range
+FTY_ALERT_LIST_EXPORT const char *
+    alert_stats_name (alert_stats_counter_t counter);
+
+// resident set size of the process in bytes
+// returns 0 if it can't be read
+FTY_ALERT_LIST_EXPORT size_t
+    alert_stats_rss (void);
+
+// log all counters with their rates per second since the previous call,
+// resident set size and its growth since the first call
+FTY_ALERT_LIST_EXPORT void
+    alert_stats_log (void);
+
+//  Self test of this class
+FTY_ALERT_LIST_EXPORT void
+    alert_stats_test (bool verbose);
+
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
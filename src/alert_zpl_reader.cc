@@ -0,0 +1,288 @@
+/*  =========================================================================
+    alert_zpl_reader - Streaming reader of ZPL state files
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/*
+@header
+    alert_zpl_reader - Streaming reader of ZPL state files
+@discuss
+    ZPL state files are a zconfig tree whose root children are alerts, as
+    written by fty_proto_zpl (): each alert starts with an unindented line,
+    its fields are indented. The reader reads the file line by line and
+    hands the lines of one alert at a time to zconfig and fty_proto, so
+    memory use is bounded by the largest alert, not by the file.
+
+    The checksum trailer is verified on the way.
+@end
+*/
+
+#include <sys/stat.h>
+#include <string>
+#include "fty_alert_list_classes.h"
+
+struct _alert_zpl_reader_t {
+    FILE *file;
+    size_t size;                // of the file
+    char *line;                 // getline () buffer
+    size_t line_size;
+    std::string record;         // lines of the alert being read
+    uint32_t crc;               // of the lines read so far
+    bool trailer;               // checksum trailer seen
+    int verify;                 // alert_zpl_reader_verify ()
+    size_t records;
+    size_t skipped;
+};
+
+alert_zpl_reader_t *
+alert_zpl_reader_new (const char *path, const char *filename)
+{
+    assert (path);
+    assert (filename);
+    char *state_file = zsys_sprintf ("%s/%s", path, filename);
+    FILE *file = state_file ? fopen (state_file, "re") : NULL;
+    zstr_free (&state_file);
+    if (!file)
+        return NULL;
+
+    alert_zpl_reader_t *self = new (std::nothrow) alert_zpl_reader_t;
+    if (!self) {
+        fclose (file);
+        return NULL;
+    }
+    struct stat st;
+    self->file = file;
+    self->size = fstat (fileno (file), &st) == 0 ? (size_t) st.st_size : 0;
+    self->line = NULL;
+    self->line_size = 0;
+    self->crc = 0;
+    self->trailer = false;
+    self->verify = 0;
+    self->records = 0;
+    self->skipped = 0;
+    return self;
+}
+
+void
+alert_zpl_reader_destroy (alert_zpl_reader_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        alert_zpl_reader_t *self = *self_p;
+        fclose (self->file);
+        free (self->line);
+        delete self;
+        *self_p = NULL;
+    }
+}
+
+// parse lines of one alert collected in self->record
+// returns new alert, NULL if the record is not an alert
+static fty_proto_t *
+s_parse_record (alert_zpl_reader_t *self)
+{
+    self->records++;
+    zchunk_t *chunk = zchunk_new (self->record.data (), self->record.size ());
+    self->record.clear ();
+    zconfig_t *root = chunk ? zconfig_chunk_load (chunk) : NULL;
+    zchunk_destroy (&chunk);
+    zconfig_t *child = root ? zconfig_child (root) : NULL;
+    fty_proto_t *alert = child ? fty_proto_new_zpl (child) : NULL;
+    zconfig_destroy (&root);
+    if (alert && fty_proto_id (alert) != FTY_PROTO_ALERT)
+        fty_proto_destroy (&alert);
+    if (!alert)
+        self->skipped++;
+    return alert;
+}
+
+fty_proto_t *
+alert_zpl_reader_next (alert_zpl_reader_t *self)
+{
+    assert (self);
+    while (true) {
+        ssize_t length = getline (&self->line, &self->line_size, self->file);
+        if (length <= 0) {
+            // last alert of the file
+            if (self->record.empty ())
+                return NULL;
+            fty_proto_t *alert = s_parse_record (self);
+            if (alert)
+                return alert;
+            continue;
+        }
+
+        const char *line = self->line;
+        if (self->trailer) {
+            // nothing but blank lines may follow the trailer
+            if (line [strspn (line, " \t\r\n")])
+                self->verify = -1;
+            continue;
+        }
+        size_t prefix = strlen (ALERT_ZPL_CHECKSUM_TRAILER);
+        if (strncmp (line, ALERT_ZPL_CHECKSUM_TRAILER, prefix) == 0) {
+            char *stop = NULL;
+            unsigned long expected = strtoul (line + prefix, &stop, 16);
+            self->trailer = true;
+            bool valid = stop != line + prefix && !stop [strspn (stop, " \t\r\n")];
+            self->verify = valid && expected == self->crc ? 1 : -1;
+            continue;
+        }
+        self->crc = alert_crc32c (self->crc, line, (size_t) length);
+
+        // comments and blank lines are no part of an alert
+        const char *text = line + strspn (line, " \t");
+        if (*text == '#' || *text == '\n' || *text == '\r' || *text == '\0')
+            continue;
+
+        fty_proto_t *alert = NULL;
+        if (line [0] != ' ' && line [0] != '\t' && !self->record.empty ())
+            alert = s_parse_record (self);
+        self->record.append (line, (size_t) length);
+        if (line [length - 1] != '\n')
+            self->record.push_back ('\n');
+        if (alert)
+            return alert;
+    }
+}
+
+size_t
+alert_zpl_reader_records (alert_zpl_reader_t *self)
+{
+    assert (self);
+    return self->records;
+}
+
+size_t
+alert_zpl_reader_skipped (alert_zpl_reader_t *self)
+{
+    assert (self);
+    return self->skipped;
+}
+
+size_t
+alert_zpl_reader_size (alert_zpl_reader_t *self)
+{
+    assert (self);
+    return self->size;
+}
+
+int
+alert_zpl_reader_verify (alert_zpl_reader_t *self)
+{
+    assert (self);
+    return self->verify;
+}
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+alert_zpl_reader_test (bool verbose)
+{
+    printf (" * alert_zpl_reader: ");
+
+    //  @selftest
+    const char *path = ".";
+    const char *filename = "test_zpl_reader";
+
+    zlistx_t *alerts = zlistx_new ();
+    zlistx_set_destructor (alerts, (czmq_destructor *) fty_proto_destroy);
+    for (int i = 0; i < 10; i++) {
+        zlist_t *actions = zlist_new ();
+        zlist_autofree (actions);
+        zlist_append (actions, (void *) "EMAIL");
+        char element [32];
+        snprintf (element, sizeof (element), "Element%d", i);
+        zlistx_add_end (alerts, alert_new ("Rule1", element, "ACTIVE", "CRITICAL", "description", i, &actions, 0));
+    }
+    assert (alert_save_state_zpl (alerts, path, filename) == 0);
+
+    // alerts come one by one, in order
+    alert_zpl_reader_t *reader = alert_zpl_reader_new (path, filename);
+    assert (reader);
+    assert (alert_zpl_reader_size (reader) > 0);
+    fty_proto_t *expected = (fty_proto_t *) zlistx_first (alerts);
+    fty_proto_t *alert;
+    while ((alert = alert_zpl_reader_next (reader))) {
+        assert (expected);
+        assert (streq (fty_proto_name (alert), fty_proto_name (expected)));
+        assert (fty_proto_time (alert) == fty_proto_time (expected));
+        assert (streq (fty_proto_action_first (alert), "EMAIL"));
+        fty_proto_destroy (&alert);
+        expected = (fty_proto_t *) zlistx_next (alerts);
+    }
+    assert (expected == NULL);
+    assert (alert_zpl_reader_next (reader) == NULL);
+    assert (alert_zpl_reader_records (reader) == 10);
+    assert (alert_zpl_reader_skipped (reader) == 0);
+    assert (alert_zpl_reader_verify (reader) == 1);
+    alert_zpl_reader_destroy (&reader);
+    assert (reader == NULL);
+
+    // data after the checksum trailer
+    {
+        FILE *file = fopen ("./test_zpl_reader", "ae");
+        assert (file);
+        fputs ("garbage\n", file);
+        fclose (file);
+        reader = alert_zpl_reader_new (path, filename);
+        size_t count = 0;
+        while ((alert = alert_zpl_reader_next (reader))) {
+            fty_proto_destroy (&alert);
+            count++;
+        }
+        assert (count == 10);
+        assert (alert_zpl_reader_verify (reader) == -1);
+        alert_zpl_reader_destroy (&reader);
+    }
+
+    // file of an older version, without checksum; record that is not an
+    // alert is skipped
+    {
+        zconfig_t *state = zconfig_new ("root", NULL);
+        fty_proto_zpl ((fty_proto_t *) zlistx_first (alerts), state);
+        assert (zconfig_save (state, "./test_zpl_reader") == 0);
+        zconfig_destroy (&state);
+        FILE *file = fopen ("./test_zpl_reader", "ae");
+        assert (file);
+        fputs ("garbage\n    key = value\n", file);
+        fclose (file);
+
+        reader = alert_zpl_reader_new (path, filename);
+        alert = alert_zpl_reader_next (reader);
+        assert (alert);
+        assert (streq (fty_proto_name (alert), "Element0"));
+        fty_proto_destroy (&alert);
+        assert (alert_zpl_reader_next (reader) == NULL);
+        assert (alert_zpl_reader_records (reader) == 2);
+        assert (alert_zpl_reader_skipped (reader) == 1);
+        assert (alert_zpl_reader_verify (reader) == 0);
+        alert_zpl_reader_destroy (&reader);
+    }
+
+    assert (alert_zpl_reader_new (path, "does_not_exist") == NULL);
+
+    zlistx_destroy (&alerts);
+    zsys_file_delete ("./test_zpl_reader");
+    zsys_file_delete ("./test_zpl_reader.prev");
+    //  @end
+
+    printf ("OK\n");
+}
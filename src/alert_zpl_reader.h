@@ -0,0 +1,75 @@
+/*  =========================================================================
+    alert_zpl_reader - Streaming reader of ZPL state files
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#ifndef ALERT_ZPL_READER_H_INCLUDED
+#define ALERT_ZPL_READER_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// checksum trailer of ZPL state files, "# crc32c 0x12345678", the last line;
+// CRC-32C covers all bytes before it. Files of older versions have none.
+#define ALERT_ZPL_CHECKSUM_TRAILER "# crc32c "
+
+// open ZPL state file 'filename' in 'path' for reading
+// returns new reader, NULL if the file can't be opened
+FTY_ALERT_LIST_EXPORT alert_zpl_reader_t *
+    alert_zpl_reader_new (const char *path, const char *filename);
+
+// close the file
+FTY_ALERT_LIST_EXPORT void
+    alert_zpl_reader_destroy (alert_zpl_reader_t **self_p);
+
+// read next alert of the file, as it was saved (description and metadata
+// encoded); records that are not alerts are skipped
+// returns new alert, NULL at the end of the file
+FTY_ALERT_LIST_EXPORT fty_proto_t *
+    alert_zpl_reader_next (alert_zpl_reader_t *self);
+
+// number of records read so far
+FTY_ALERT_LIST_EXPORT size_t
+    alert_zpl_reader_records (alert_zpl_reader_t *self);
+
+// number of records skipped so far
+FTY_ALERT_LIST_EXPORT size_t
+    alert_zpl_reader_skipped (alert_zpl_reader_t *self);
+
+// size of the file in bytes
+FTY_ALERT_LIST_EXPORT size_t
+    alert_zpl_reader_size (alert_zpl_reader_t *self);
+
+// checksum of the file, once alert_zpl_reader_next () returned NULL
+// 1 - matches, 0 - the file has none, -1 - mismatch or data after the trailer
+FTY_ALERT_LIST_EXPORT int
+    alert_zpl_reader_verify (alert_zpl_reader_t *self);
+
+//  Self test of this class
+FTY_ALERT_LIST_EXPORT void
+    alert_zpl_reader_test (bool verbose);
+
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -26,68 +26,116 @@
 @end
  */
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
 #include <string>
+#include <system_error>
+#include <thread>
+#include <unordered_set>
+#include <vector>
 #include <fty_common_utf8.h>
 #include "fty_alert_list_classes.h"
 
-// encode a c-string S (z85 encoding)
-// returns the encoded buffer (c-string)
-// returns NULL if error or if input S string is NULL
-// Note: returned ptr must be freed by caller
+// Escaping of values of the ZPL state file zconfig can't keep as they are:
+// z85 of the value zero-padded to a multiple of 4 bytes. Buffers are reused
+// from one value to the next, returned strings are valid until next call.
+class s_value_codec {
+    public:
+        // is 'value' kept as it is? Printable ASCII but double quote and
+        // backslash is, checked 8 bytes at a time.
+        static bool plain (const char *value) {
+            if (!value)
+                return true;
+            size_t size = strlen (value);
+            const unsigned char *bytes = (const unsigned char *) value;
+            const uint64_t ones = 0x0101010101010101ULL;
+            const uint64_t highs = 0x8080808080808080ULL;
+            for (; size >= sizeof (uint64_t); size -= sizeof (uint64_t), bytes += sizeof (uint64_t)) {
+                uint64_t word;
+                memcpy (&word, bytes, sizeof (word));
+                uint64_t special = word | ((word - ones * 0x20) & ~word) |
+                    s_zero (word ^ (ones * '"')) | s_zero (word ^ (ones * '\\')) |
+                    s_zero (word ^ (ones * 0x7f));
+                if (special & highs)
+                    return false;
+            }
+            for (; size; size--, bytes++) {
+                if (*bytes < 0x20 || *bytes >= 0x7f || *bytes == '"' || *bytes == '\\')
+                    return false;
+            }
+            return true;
+        }
 
-static char *
-s_string_encode(const char *s)
-{
-    if (!s) return NULL;
-    size_t s_size = strlen (s);
-
-    // z85 padding, new size is the next bigger or equal multiple of 4
-    size_t padded_size = (s_size + 3) & 0xFFFFFFFC;
-    uint8_t *s_padded = (uint8_t *) zmalloc (padded_size);
-    if (!s_padded)
-        { log_error("allocation failed"); return NULL; }
-    memcpy (s_padded, s, s_size);
-    if (padded_size > s_size) // pad with ZEROs
-        memset (s_padded + s_size, 0, padded_size - s_size);
-
-    size_t encoded_size = 1 + (5 * padded_size) / 4;
-    char *s_encoded = (char *) zmalloc (encoded_size);
-    if (!s_encoded)
-        { free(s_padded); log_error("allocation failed"); return NULL; }
-
-    zmq_z85_encode (s_encoded, s_padded, padded_size);
-    free(s_padded);
-
-    log_trace ("s_string_encode('%s') = '%s'", s, s_encoded);
-    return s_encoded;
-}
+        const char *encode (const char *value) {
+            size_t size = strlen (value);
+            // z85 padding, new size is the next bigger or equal multiple of 4
+            m_padded.assign (value, size);
+            m_padded.resize ((size + 3) & ~(size_t) 3, '\0');
+            m_coded.resize (1 + 5 * m_padded.size () / 4);
+            zmq_z85_encode (&m_coded [0], (const uint8_t *) m_padded.data (), m_padded.size ());
+            return m_coded.data ();
+        }
 
-// decode a c-string S (assume z85 encoded, see s_string_encode())
-// returns the decoded buffer (c-string)
-// returns NULL if error or if input S string is NULL
-// Note: returned ptr must be freed by caller
+        // returns NULL if 'value' is not z85
+        const char *decode (const char *value) {
+            size_t size = strlen (value);
+            m_coded.assign (1 + 4 * size / 5, '\0');
+            if (size % 5 || !zmq_z85_decode ((uint8_t *) &m_coded [0], value))
+                return NULL;
+            return m_coded.data ();
+        }
 
-static char *
-s_string_decode(const char *s)
-{
-    if (!s) return NULL;
-    size_t s_size = strlen (s);
+    private:
+        // high bit set in bytes of 'word' that are zero (or right above a
+        // zero byte, which doesn't matter for the check)
+        static uint64_t s_zero (uint64_t word) {
+            return (word - 0x0101010101010101ULL) & ~word;
+        }
+
+        std::string m_padded;
+        std::string m_coded;
+};
 
-    size_t decoded_size = 1 + (5 * s_size) / 4;
-    char *s_decoded = (char *) zmalloc (decoded_size);
-    if (!s_decoded)
-        { log_error("alloc failed"); return NULL; }
+static thread_local s_value_codec s_codec;
 
-    zmq_z85_decode ((uint8_t*)s_decoded, s);
+void
+alert_state_escape (fty_proto_t *alert)
+{
+    assert (alert);
+    int escaped = 0;
+    if (!s_value_codec::plain (fty_proto_description (alert))) {
+        fty_proto_set_description (alert, "%s", s_codec.encode (fty_proto_description (alert)));
+        escaped |= STATE_ESCAPED_DESCRIPTION;
+    }
+    if (!s_value_codec::plain (fty_proto_metadata (alert))) {
+        fty_proto_set_metadata (alert, "%s", s_codec.encode (fty_proto_metadata (alert)));
+        escaped |= STATE_ESCAPED_METADATA;
+    }
+    fty_proto_aux_insert (alert, STATE_AUX_ESCAPED, "%d", escaped);
+}
 
-    // remove end padding chars (if any)
-    //std::string str(s_decoded);
-    //std::string::size_type pos = str.find_last_not_of ("<padchar>");
-    //if (pos != std::string::npos)
-    //    s_decoded[pos + 1] = 0; // trim right
+void
+alert_state_unescape (fty_proto_t *alert)
+{
+    assert (alert);
+    // older versions escaped both, always
+    int escaped = STATE_ESCAPED_DESCRIPTION | STATE_ESCAPED_METADATA;
+    zhash_t *aux = fty_proto_aux (alert);
+    const char *flags = aux ? (const char *) zhash_lookup (aux, STATE_AUX_ESCAPED) : NULL;
+    if (flags) {
+        escaped = atoi (flags);
+        zhash_delete (aux, STATE_AUX_ESCAPED);
+    }
 
-    log_trace ("s_string_decode('%s') = '%s'", s, s_decoded);
-    return s_decoded;
+    const char *decoded;
+    if ((escaped & STATE_ESCAPED_DESCRIPTION) && fty_proto_description (alert) &&
+            (decoded = s_codec.decode (fty_proto_description (alert))))
+        fty_proto_set_description (alert, "%s", decoded);
+    if ((escaped & STATE_ESCAPED_METADATA) && fty_proto_metadata (alert) &&
+            (decoded = s_codec.decode (fty_proto_metadata (alert))))
+        fty_proto_set_metadata (alert, "%s", decoded);
 }
 
 int
@@ -169,79 +217,216 @@ alert_comparator(fty_proto_t *alert1, fty_proto_t *alert2) {
     return 0;
 }
 
+// names of alert_state_t values, indexed by the value
+static const char *s_state_names [] = {
+    NULL,
+    "ACTIVE",
+    "ACK-WIP",
+    "ACK-IGNORE",
+    "ACK-PAUSE",
+    "ACK-SILENCE",
+    "RESOLVED",
+    "ALL",
+    "ALL-ACTIVE"
+};
+
+// names of alert_severity_t values, indexed by the value
+static const char *s_severity_names [] = {
+    NULL,
+    "INFO",
+    "WARNING",
+    "CRITICAL"
+};
+
+alert_state_t
+alert_state_from_string(const char *state) {
+    if (NULL == state)
+        return ALERT_STATE_UNKNOWN;
+    for (int i = ALERT_STATE_ACTIVE; i <= ALERT_STATE_ALL_ACTIVE; i++) {
+        if (streq(state, s_state_names[i]))
+            return (alert_state_t) i;
+    }
+    return ALERT_STATE_UNKNOWN;
+}
+
+const char *
+alert_state_string(alert_state_t state) {
+    if (state <= ALERT_STATE_UNKNOWN || state > ALERT_STATE_ALL_ACTIVE)
+        return NULL;
+    return s_state_names[state];
+}
+
+alert_severity_t
+alert_severity_from_string(const char *severity) {
+    if (NULL == severity)
+        return ALERT_SEVERITY_UNKNOWN;
+    for (int i = ALERT_SEVERITY_INFO; i <= ALERT_SEVERITY_CRITICAL; i++) {
+        if (streq(severity, s_severity_names[i]))
+            return (alert_severity_t) i;
+    }
+    return ALERT_SEVERITY_UNKNOWN;
+}
+
+const char *
+alert_severity_string(alert_severity_t severity) {
+    if (severity <= ALERT_SEVERITY_UNKNOWN || severity > ALERT_SEVERITY_CRITICAL)
+        return NULL;
+    return s_severity_names[severity];
+}
+
 int
-is_acknowledge_state(const char *state) {
-    if (NULL != state && (streq(state, "ACK-WIP") ||
-            streq(state, "ACK-IGNORE") ||
-            streq(state, "ACK-PAUSE") ||
-            streq(state, "ACK-SILENCE"))) {
-        return 1;
+alert_state_is_acknowledge(alert_state_t state) {
+    return state >= ALERT_STATE_ACK_WIP && state <= ALERT_STATE_ACK_SILENCE;
+}
+
+int
+alert_state_is_alert(alert_state_t state) {
+    return state >= ALERT_STATE_ACTIVE && state <= ALERT_STATE_RESOLVED;
+}
+
+int
+alert_state_included(alert_state_t list_request_state, alert_state_t alert) {
+    if (!alert_state_is_alert(alert))
+        return 0;
+    switch (list_request_state) {
+        case ALERT_STATE_ALL:
+            return 1;
+        case ALERT_STATE_ALL_ACTIVE:
+            return alert != ALERT_STATE_RESOLVED;
+        case ALERT_STATE_UNKNOWN:
+            return 0;
+        default:
+            return list_request_state == alert;
     }
-    return 0;
+}
+
+int
+is_acknowledge_state(const char *state) {
+    return alert_state_is_acknowledge(alert_state_from_string(state));
 }
 
 int
 is_alert_state(const char *state) {
-    if (NULL != state && (streq(state, "ACTIVE") ||
-            streq(state, "RESOLVED") ||
-            is_acknowledge_state(state))) {
-        return 1;
-    }
-    return 0;
+    return alert_state_is_alert(alert_state_from_string(state));
 }
 
 int
 is_list_request_state(const char *state) {
-    if (NULL != state && (streq(state, "ALL") ||
-            streq(state, "ALL-ACTIVE") ||
-            is_alert_state(state))) {
-        return 1;
-    }
-    return 0;
+    return alert_state_from_string(state) != ALERT_STATE_UNKNOWN;
 }
 
 int
 is_state_included(const char *list_request_state, const char *alert) {
-    if (!is_list_request_state(list_request_state))
-        return 0;
-    if (!is_alert_state(alert))
-        return 0;
-
-    if (streq(list_request_state, "ALL"))
-        return 1;
-    if (streq(list_request_state, "ALL-ACTIVE") && !streq(alert, "RESOLVED"))
-        return 1;
-    return streq(list_request_state, alert);
+    return alert_state_included(alert_state_from_string(list_request_state),
+            alert_state_from_string(alert));
 }
 
 int
 is_acknowledge_request_state(const char *state) {
-    if (NULL != state && (streq(state, "ACTIVE") ||
-            is_acknowledge_state(state))) {
-        return 1;
-    }
-    return 0;
+    alert_state_t id = alert_state_from_string(state);
+    return id == ALERT_STATE_ACTIVE || alert_state_is_acknowledge(id);
 }
 
-// 0 - ok, -1 - error
-
-static int
-s_alerts_input_checks(zlistx_t *alerts, fty_proto_t *alert) {
+// identities of alerts in 'alerts', sized for 'expected' more of them
+static std::unordered_set<const char *>
+s_alerts_identities (zlistx_t *alerts, size_t expected) {
     assert(alerts);
-    assert(alert);
 
+    std::unordered_set<const char *> identities;
+    identities.reserve (zlistx_size (alerts) + expected);
     fty_proto_t *cursor = (fty_proto_t *) zlistx_first(alerts);
     while (cursor) {
-        if (alert_id_comparator(cursor, alert) == 0) {
-            // We already have 'alert' in zlistx 'alerts'
-            return -1;
-        }
+        const char *identity = alert_intern_identity (fty_proto_rule (cursor), fty_proto_name (cursor));
+        if (identity)
+            identities.insert (identity);
         cursor = (fty_proto_t *) zlistx_next(alerts);
     }
+    return identities;
+}
+
+// 'alert' is new to 'identities' (and added to them)?
+// 0 - ok, -1 - error
+static int
+s_alerts_input_checks(std::unordered_set<const char *> &identities, fty_proto_t *alert) {
+    assert(alert);
 
+    const char *identity = alert_intern_identity (fty_proto_rule (alert), fty_proto_name (alert));
+    if (identity && !identities.insert (identity).second) {
+        // We already have 'alert' in zlistx 'alerts'
+        return -1;
+    }
     return 0;
 }
 
+// records decoded by a thread at least, and most threads decoding them
+#define LOAD_RECORDS_PER_THREAD 1024
+#define LOAD_THREADS_MAX        8
+
+static std::atomic<size_t> loadThreads (LOAD_THREADS_MAX);
+
+void
+alert_load_set_threads (size_t threads)
+{
+    loadThreads = threads ? threads : LOAD_THREADS_MAX;
+}
+
+// Decode 'count' independent records of a state file with 'decode (index)',
+// which returns new alert or NULL for a malformed record, and append them to
+// 'alerts' in record order, without duplicates. Ranges of records are
+// decoded into local buffers by a thread per core; the merge is sequential.
+// returns number of malformed records
+template <typename Decode> static size_t
+s_alerts_decode (zlistx_t *alerts, size_t count, Decode decode)
+{
+    size_t threads = std::min ((size_t) std::max (std::thread::hardware_concurrency (), 1u), loadThreads.load ());
+    threads = std::max (std::min (threads, count / LOAD_RECORDS_PER_THREAD), (size_t) 1);
+    std::vector<std::vector<fty_proto_t *>> decoded (threads);
+    auto work = [&] (size_t part) {
+        size_t begin = count * part / threads;
+        size_t end = count * (part + 1) / threads;
+        decoded [part].reserve (end - begin);
+        for (size_t index = begin; index < end; index++)
+            decoded [part].push_back (decode (index));
+    };
+
+    std::vector<std::thread> pool;
+    for (size_t part = 1; part < threads; part++) {
+        try {
+            pool.emplace_back (work, part);
+        }
+        catch (const std::system_error &) {
+            work (part);
+        }
+    }
+    work (0);
+    for (auto &thread : pool)
+        thread.join ();
+
+    std::unordered_set<const char *> identities = s_alerts_identities (alerts, count);
+    size_t malformed = 0;
+    for (auto &part : decoded) {
+        for (fty_proto_t *alert : part) {
+            if (!alert) {
+                malformed++;
+                continue;
+            }
+            if (s_alerts_input_checks (identities, alert)) {
+                log_warning (
+                        "Alert id (%s, %s) already read.",
+                        fty_proto_rule(alert),
+                        fty_proto_name(alert));
+                fty_proto_destroy (&alert);
+                continue;
+            }
+            void *handle = zlistx_add_end (alerts, alert);
+            // list with a duplicator keeps its own copy
+            if (zlistx_handle_item (handle) != alert)
+                fty_proto_destroy (&alert);
+        }
+    }
+    return malformed;
+}
+
 // load alert state from disk - legacy
 // 0 - success, -1 - error
 static int
@@ -279,13 +464,15 @@ s_alert_load_state_legacy (zlistx_t *alerts, const char *path, const char *filen
     }
 
     zchunk_t *chunk = zchunk_read(zfile_handle(file), cursize);
-    assert(chunk);
-    zframe_t *frame = zframe_new(zchunk_data(chunk), zchunk_size(chunk));
-    assert(frame);
+    zframe_t *frame = chunk ? zframe_new(zchunk_data(chunk), zchunk_size(chunk)) : NULL;
     zchunk_destroy(&chunk);
 
     zfile_close(file);
     zfile_destroy(&file);
+    if (!frame) {
+        log_error("cannot read %s/%s", path, filename);
+        return -1;
+    }
 
     /* Note: Protocol data uses 8-byte sized words, and zmsg_XXcode and file
      * functions deal with platform-dependent unsigned size_t and signed off_t.
@@ -296,10 +483,29 @@ s_alert_load_state_legacy (zlistx_t *alerts, const char *path, const char *filen
     off_t offset = 0;
     log_debug("zfile_cursize == %jd", (intmax_t) cursize);
 
-    while (offset < cursize) {
-        byte *prefix = zframe_data(frame) + offset;
-        byte *data = zframe_data(frame) + offset + sizeof (uint64_t);
-        offset += (uint64_t) * prefix + sizeof (uint64_t);
+    // records must fill the file exactly, anything else is not a legacy
+    // state file or it was torn
+    // each record is prefixed by its size, a host order uint64_t
+    std::vector<off_t> records;
+    std::vector<uint64_t> sizes;
+    while (cursize - offset >= (off_t) sizeof (uint64_t)) {
+        uint64_t size;
+        memcpy (&size, zframe_data(frame) + offset, sizeof (size));
+        if (size > (uint64_t) (cursize - offset) - sizeof (uint64_t))
+            break;
+        records.push_back (offset);
+        sizes.push_back (size);
+        offset += (off_t) (size + sizeof (uint64_t));
+    }
+    if (offset != cursize) {
+        log_error("%s/%s is not a valid legacy state file", path, filename);
+        zframe_destroy(&frame);
+        return -1;
+    }
+
+    size_t malformed = s_alerts_decode (alerts, records.size (), [&] (size_t index) {
+        byte *data = zframe_data(frame) + records [index] + sizeof (uint64_t);
+        size_t size = (size_t) sizes [index];
 
         /* Note: the CZMQ_VERSION_MAJOR comparison below actually assumes versions
          * we know and care about - v3.0.2 (our legacy default, already obsoleted
@@ -308,36 +514,28 @@ s_alert_load_state_legacy (zlistx_t *alerts, const char *path, const char *filen
          */
         zmsg_t *zmessage = NULL;
 #if CZMQ_VERSION_MAJOR == 3
-        zmessage = zmsg_decode(data, (size_t) * prefix);
+        zmessage = zmsg_decode(data, size);
 #else
         {
-            zframe_t *fr = zframe_new(data, (size_t) * prefix);
+            zframe_t *fr = zframe_new(data, size);
             zmessage = zmsg_decode(fr);
             zframe_destroy(&fr);
         }
 #endif
-        assert (zmessage);
-        fty_proto_t *alert = fty_proto_decode (&zmessage); // zmessage destroyed
-        if (!alert) {
-            log_warning ("Ignoring malformed alert in %s/%s", path, filename);
-            continue;
-        }
-        if (s_alerts_input_checks (alerts, alert) == 0) {
-            zlistx_add_end (alerts, alert);
-        }
-        else {
-            log_warning (
-                    "Alert id (%s, %s) already read.",
-                    fty_proto_rule(alert),
-                    fty_proto_name(alert));
-        }
-        fty_proto_destroy(&alert);
-    }
+        return zmessage ? fty_proto_decode (&zmessage) : NULL; // zmessage destroyed
+    });
+    if (malformed)
+        log_warning ("Ignoring %zu malformed alerts in %s/%s", malformed, path, filename);
 
     zframe_destroy(&frame);
     return 0;
 }
 
+// previous generation of the state file, kept by alert_state_install ()
+#define STATE_PREVIOUS_SUFFIX ".prev"
+
+// load alert state from disk - ZPL, one alert at a time
+// 0 - success, -1 - error, -2 - checksum mismatch
 static int
 s_alert_load_state_new (zlistx_t *alerts, const char *path, const char *filename) {
     if (!alerts || !path || !filename) {
@@ -345,94 +543,94 @@ s_alert_load_state_new (zlistx_t *alerts, const char *path, const char *filename
         return -1;
     }
 
-    char *state_file = zsys_sprintf ("%s/%s", path, filename);
-    /* This is unrolled version of zconfig_load() which deallocates file before handing it to config
-     * in case of success.
-     * I'm not sure whether we can do this always, or whether this is specific to fty-proto state files
-     * - that's the reason for unrolling.
-     */
-    zconfig_t *state = NULL;
-    zfile_t *file = zfile_new (path, filename);
-
-    if (zfile_input (file) == 0) {
-        zchunk_t *chunk = zfile_read (file, zfile_cursize (file), 0);
-        if (chunk) {
-            state = zconfig_chunk_load (chunk);
-            zchunk_destroy (&chunk);
-            zfile_close (file);
-            zfile_destroy (&file);
-            file = NULL;        //  Config tree now owns file handle
-        }
-    }
-    zfile_destroy (&file);
-
-    if (!state) {
-        log_error ("cannot load state from file %s", state_file);
-        zconfig_destroy (&state);
-        zstr_free (&state_file);
+    alert_zpl_reader_t *reader = alert_zpl_reader_new (path, filename);
+    if (!reader) {
+        log_error ("cannot load state from file %s/%s", path, filename);
         return -1;
     }
 
-    zconfig_t *cursor = zconfig_child (state);
-    if (!cursor) {
-        log_error ("no correct alert in the file %s", state_file);
-        zconfig_destroy (&state);
-        zstr_free (&state_file);
-        return -1;
-    }
+    // a few hundred bytes per alert
+    std::unordered_set<const char *> identities = s_alerts_identities (alerts, alert_zpl_reader_size (reader) / 256);
 
-    log_debug ("loading alerts from file %s", state_file);
-    while (cursor) {
-        fty_proto_t *alert = fty_proto_new_zpl (cursor);
-        if (!alert) {
-            log_warning ("Ignoring malformed alert in %s", state_file);
-            cursor = zconfig_next (cursor);
-            continue;
-        }
-
-        // decode encoded attributes (see alert_save_state())
-        {
-            char* decoded;
-            decoded = s_string_decode (fty_proto_description (alert));
-            fty_proto_set_description (alert, "%s", decoded);
-            zstr_free (&decoded);
-            decoded = s_string_decode (fty_proto_metadata (alert));
-            fty_proto_set_metadata (alert, "%s", decoded);
-            zstr_free (&decoded);
-        }
+    log_debug ("loading alerts from file %s/%s", path, filename);
+    size_t loaded = 0;
+    fty_proto_t *alert;
+    while ((alert = alert_zpl_reader_next (reader))) {
+        alert_state_unescape (alert);
 
-        fty_proto_print (alert);
-
-        if (s_alerts_input_checks (alerts, alert)) {
+        if (s_alerts_input_checks (identities, alert)) {
             log_warning (
                     "Alert id (%s, %s) already read.",
                     fty_proto_rule(alert),
                     fty_proto_name(alert));
+            fty_proto_destroy (&alert);
         }
         else {
-            zlistx_add_end (alerts, alert);
+            void *handle = zlistx_add_end (alerts, alert);
+            // list with a duplicator keeps its own copy
+            if (zlistx_handle_item (handle) != alert)
+                fty_proto_destroy (&alert);
         }
-
-        cursor = zconfig_next (cursor);
+        loaded++;
     }
 
-    zconfig_destroy (&state);
-    zstr_free (&state_file);
+    int verify = alert_zpl_reader_verify (reader);
+    size_t skipped = alert_zpl_reader_skipped (reader);
+    alert_zpl_reader_destroy (&reader);
+    if (skipped)
+        log_warning ("Ignoring %zu malformed alerts in %s/%s", skipped, path, filename);
+    if (verify == -1) {
+        log_error ("checksum of state file %s/%s doesn't match", path, filename);
+        return -2;
+    }
+    // file with a valid checksum may hold no alert
+    if (!loaded && verify != 1) {
+        log_error ("no correct alert in the file %s/%s", path, filename);
+        return -1;
+    }
     return 0;
 }
 
-int
-alert_load_state (zlistx_t *alerts, const char *path, const char *filename)
+// does file 'filename' in 'path' start with 'magic'?
+static bool
+s_file_starts_with (const char *path, const char *filename, const char *magic)
 {
-    log_info("loading alerts from %s/%s ...", path, filename);
+    char *name = zsys_sprintf ("%s/%s", path, filename);
+    FILE *file = name ? fopen (name, "rb") : NULL;
+    zstr_free (&name);
+    if (!file)
+        return false;
+    char head [16];
+    size_t length = strlen (magic);
+    assert (length <= sizeof (head));
+    bool starts = fread (head, 1, length, file) == length && memcmp (head, magic, length) == 0;
+    fclose (file);
+    return starts;
+}
 
-    if (!alerts || !path || !filename) {
-        log_error ("cannot load state");
+// load one generation of the state file; nothing is added on error
+// 0 - success, -1 - error
+static int
+s_alert_load_generation (zlistx_t *alerts, const char *path, const char *filename)
+{
+    alert_image_t *image = alert_image_open (path, filename);
+    if (image) {
+        size_t count = alert_image_count (image);
+        s_alerts_decode (alerts, count, [&] (size_t index) {
+            return alert_image_decode (image, index);
+        });
+        log_debug ("%zu alerts loaded from the state image", count);
+        alert_image_destroy (&image);
+        return 0;
+    }
+    if (s_file_starts_with (path, filename, ALERT_IMAGE_MAGIC)) {
+        log_error ("state image %s/%s is corrupted", path, filename);
         return -1;
     }
 
+    size_t size = zlistx_size (alerts);
     int rv = s_alert_load_state_new (alerts, path, filename);
-    if (rv != 0) {
+    if (rv == -1) {
         log_warning("s_alert_load_state_new() failed (rv: %d)", rv);
         log_info("retry using s_alert_load_state_legacy()...");
 
@@ -441,6 +639,45 @@ alert_load_state (zlistx_t *alerts, const char *path, const char *filename)
             log_error("s_alert_load_state_legacy() failed (rv: %d)", rv);
         }
     }
+    if (rv != 0) {
+        // drop what was loaded before the error
+        while (zlistx_size (alerts) > size) {
+            zlistx_last (alerts);
+            zlistx_delete (alerts, zlistx_cursor (alerts));
+        }
+        return -1;
+    }
+    return 0;
+}
+
+int
+alert_load_state (zlistx_t *alerts, const char *path, const char *filename)
+{
+    log_info("loading alerts from %s/%s ...", path, filename);
+
+    if (!alerts || !path || !filename) {
+        log_error ("cannot load state");
+        return -1;
+    }
+
+    int rv = s_alert_load_generation (alerts, path, filename);
+    if (rv != 0) {
+        char *previous = zsys_sprintf ("%s%s", filename, STATE_PREVIOUS_SUFFIX);
+        char *previous_file = zsys_sprintf ("%s/%s", path, previous);
+        if (zsys_file_exists (previous_file)) {
+            log_warning ("state file %s/%s can't be loaded, using previous %s", path, filename, previous_file);
+            rv = s_alert_load_generation (alerts, path, previous);
+        }
+        zstr_free (&previous_file);
+        zstr_free (&previous);
+    }
+
+    // changes made since the state file was saved
+    int replayed = alert_journal_replay (alerts, path, filename);
+    if (replayed > 0) {
+        log_info("%d changes replayed from the journal", replayed);
+        rv = 0;
+    }
 
     return rv;
 }
@@ -457,40 +694,132 @@ alert_save_state(zlistx_t *alerts, const char *path, const char *filename, bool
         return -1;
     }
 
+    if (alert_image_save (alerts, path, filename) == 0)
+        return 0;
+    // host can't write images (big endian)
+    return alert_save_state_zpl (alerts, path, filename);
+}
+
+// save alert state to disk in ZPL format
+// 0 - success, -1 - error
+int
+alert_save_state_zpl (zlistx_t *alerts, const char *path, const char *filename)
+{
+    if (!alerts || !path || !filename) {
+        log_error ("cannot save state");
+        return -1;
+    }
+
     zconfig_t *state = zconfig_new ("root", NULL);
     fty_proto_t *cursor = (fty_proto_t *) zlistx_first (alerts);
 
     while (cursor) {
-        fty_proto_print (cursor);
-
-        // encode -complex- attributes of alert,
-        // typically/mostly those who are json payloads or non ascii
-        // *needed* due to zconfig_save()/zconfig_chunk_load() weakness
-        {
-            char *encoded;
-            encoded = s_string_encode(fty_proto_description (cursor));
-            fty_proto_set_description (cursor, "%s", encoded);
-            zstr_free(&encoded);
-            encoded = s_string_encode(fty_proto_metadata (cursor));
-            fty_proto_set_metadata (cursor, "%s", encoded);
-            zstr_free(&encoded);
+        // escape -complex- attributes of alert, typically/mostly those
+        // who are json payloads or non ascii, *needed* due to
+        // zconfig_save()/zconfig_chunk_load() weakness; on a private copy,
+        // 'alerts' may be the live cache
+        fty_proto_t *copy = fty_proto_dup (cursor);
+        if (!copy) {
+            zconfig_destroy (&state);
+            return -1;
         }
+        alert_state_escape (copy);
 
-        fty_proto_zpl (cursor, state);
+        fty_proto_zpl (copy, state);
+        fty_proto_destroy (&copy);
         cursor = (fty_proto_t *) zlistx_next (alerts);
     }
 
+    zchunk_t *chunk = zconfig_chunk_save (state);
+    zconfig_destroy (&state);
+    if (!chunk)
+        return -1;
+    char *trailer = zsys_sprintf ("%s0x%08x\n", ALERT_ZPL_CHECKSUM_TRAILER,
+        alert_crc32c (0, zchunk_data (chunk), zchunk_size (chunk)));
+    zchunk_extend (chunk, trailer, strlen (trailer));
+    zstr_free (&trailer);
+
+    int rv = alert_state_write (path, filename, zchunk_data (chunk), zchunk_size (chunk));
+    zchunk_destroy (&chunk);
+    return rv;
+}
+
+int
+alert_state_write (const char *path, const char *filename, const void *data, size_t size)
+{
+    if (!path || !filename || (!data && size)) {
+        log_error ("cannot write state");
+        return -1;
+    }
+
+    char *temporary = zsys_sprintf ("%s/%s%s", path, filename, STATE_TEMPORARY_SUFFIX);
+    int rv = -1;
+
+    int fd = open (temporary, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (fd == -1)
+        log_error ("cannot create %s: %s", temporary, strerror (errno));
+    else {
+        const char *bytes = (const char *) data;
+        size_t written = 0;
+        while (written < size) {
+            ssize_t n = write (fd, bytes + written, size - written);
+            if (n == -1 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                break;
+            written += (size_t) n;
+        }
+        bool synced = written == size && fsync (fd) == 0;
+        if (close (fd) != 0)
+            synced = false;
+
+        if (!synced) {
+            log_error ("cannot write %s: %s", temporary, strerror (errno));
+            unlink (temporary);
+        }
+        else
+            rv = alert_state_install (path, filename);
+    }
+
+    zstr_free (&temporary);
+    return rv;
+}
+
+int
+alert_state_install (const char *path, const char *filename)
+{
+    assert (path);
+    assert (filename);
     char *state_file = zsys_sprintf ("%s/%s", path, filename);
-    int rv = zconfig_save (state, state_file);
-    if (rv == -1) {
-        zstr_free (&state_file);
-        zconfig_destroy (&state);
-        return rv;
+    char *temporary = zsys_sprintf ("%s%s", state_file, STATE_TEMPORARY_SUFFIX);
+    char *previous = zsys_sprintf ("%s%s", state_file, STATE_PREVIOUS_SUFFIX);
+    int rv = -1;
+
+    // the state file keeps its name until the rename replaces it
+    if (unlink (previous) != 0 && errno != ENOENT)
+        log_error ("cannot remove %s: %s", previous, strerror (errno));
+    else
+    if (link (state_file, previous) != 0 && errno != ENOENT)
+        log_error ("cannot keep %s as %s: %s", state_file, previous, strerror (errno));
+    else
+    if (rename (temporary, state_file) != 0)
+        log_error ("cannot rename %s to %s: %s", temporary, state_file, strerror (errno));
+    else {
+        // make the link and the rename durable
+        int dir = open (path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dir != -1) {
+            fsync (dir);
+            close (dir);
+        }
+        rv = 0;
     }
+    if (rv != 0)
+        unlink (temporary);
 
+    zstr_free (&previous);
+    zstr_free (&temporary);
     zstr_free (&state_file);
-    zconfig_destroy (&state);
-    return 0;
+    return rv;
 }
 
 fty_proto_t*
@@ -517,6 +846,60 @@ alert_new(const char *rule,
     return alert;
 }
 
+// CRC-32C lookup table, reflected polynomial 0x82F63B78
+struct s_crc32c_table_t {
+    uint32_t entries [256];
+    s_crc32c_table_t () {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; bit++)
+                crc = (crc >> 1) ^ (0x82F63B78 & (0 - (crc & 1)));
+            entries [i] = crc;
+        }
+    }
+};
+
+#if defined (__x86_64__) && defined (__GNUC__)
+// CRC-32C instruction of SSE 4.2, 8 bytes at a time
+__attribute__ ((target ("sse4.2"))) static uint32_t
+s_crc32c_sse42 (uint32_t crc, const uint8_t *bytes, size_t size)
+{
+    uint64_t crc64 = crc;
+    for (; size >= sizeof (uint64_t); size -= sizeof (uint64_t), bytes += sizeof (uint64_t)) {
+        uint64_t word;
+        memcpy (&word, bytes, sizeof (word));
+        crc64 = __builtin_ia32_crc32di (crc64, word);
+    }
+    crc = (uint32_t) crc64;
+    while (size--)
+        crc = __builtin_ia32_crc32qi (crc, *bytes++);
+    return crc;
+}
+
+static bool
+s_crc32c_sse42_supported (void)
+{
+    __builtin_cpu_init ();
+    return __builtin_cpu_supports ("sse4.2");
+}
+#endif
+
+uint32_t
+alert_crc32c (uint32_t crc, const void *data, size_t size)
+{
+    const uint8_t *bytes = (const uint8_t *) data;
+    crc = ~crc;
+#if defined (__x86_64__) && defined (__GNUC__)
+    static const bool hardware = s_crc32c_sse42_supported ();
+    if (hardware)
+        return ~s_crc32c_sse42 (crc, bytes, size);
+#endif
+    static const s_crc32c_table_t table;
+    while (size--)
+        crc = (crc >> 8) ^ table.entries [(crc ^ *bytes++) & 0xff];
+    return ~crc;
+}
+
 //  --------------------------------------------------------------------------
 //  Self test of this class
 
@@ -528,7 +911,7 @@ alerts_utils_test(bool verbose) {
     log_debug(" * alerts_utils: ");
 
     //  **************************************
-    //  *****   s_string_encode/decode   *****
+    //  *****   s_value_codec            *****
     //  **************************************
 
     {
@@ -567,24 +950,57 @@ alerts_utils_test(bool verbose) {
             NULL
         };
 
-        assert(s_string_encode(NULL) == NULL);
-        assert(s_string_decode(NULL) == NULL);
-
+        s_value_codec codec;
         for (int i = 0; test[i]; i++) {
             const char* message = test[i];
 
-            char* encoded = s_string_encode(message);
+            const char* encoded = codec.encode(message);
             assert(encoded);
+            assert(s_value_codec::plain(encoded));
+            std::string copy(encoded);
 
-            char* decoded = s_string_decode(encoded);
+            const char* decoded = codec.decode(copy.c_str());
             assert(decoded);
             assert(streq(message, decoded));
-
-            zstr_free(&encoded);
-            zstr_free(&decoded);
         }
+        assert(codec.decode("not z85") == NULL);
+
+        // values zconfig keeps as they are, whatever their alignment
+        assert(s_value_codec::plain(NULL));
+        assert(s_value_codec::plain(""));
+        assert(s_value_codec::plain("hello world! { 'x': 30 } (#1) @ 50% $x"));
+        assert(s_value_codec::plain("0123456789abcdef0123456789abcdef~"));
+        for (size_t at = 0; at < 20; at++) {
+            for (const char special : { '"', '\\', '\n', '\x7f', '\x80' }) {
+                std::string value(20, 'a');
+                value[at] = special;
+                assert(!s_value_codec::plain(value.c_str()));
+            }
+        }
+        assert(!s_value_codec::plain("UTF-8: HЯɅȤ"));
+
+        // escaped fields are flagged, older files have them all escaped
+        zlist_t *actions = zlist_new();
+        zlist_autofree(actions);
+        fty_proto_t *alert = alert_new("Rule", "Element", "ACTIVE", "high", "plain description", 1, &actions, 0);
+        fty_proto_set_metadata(alert, "%s", "{ \"json\": \"value\" }");
+        alert_state_escape(alert);
+        assert(streq(fty_proto_description(alert), "plain description"));
+        assert(!streq(fty_proto_metadata(alert), "{ \"json\": \"value\" }"));
+        assert(fty_proto_aux_number(alert, STATE_AUX_ESCAPED, 0) == STATE_ESCAPED_METADATA);
+        alert_state_unescape(alert);
+        assert(streq(fty_proto_description(alert), "plain description"));
+        assert(streq(fty_proto_metadata(alert), "{ \"json\": \"value\" }"));
+        assert(fty_proto_aux_string(alert, STATE_AUX_ESCAPED, NULL) == NULL);
+
+        fty_proto_set_description(alert, "%s", codec.encode("old description"));
+        fty_proto_set_metadata(alert, "%s", codec.encode(""));
+        alert_state_unescape(alert);
+        assert(streq(fty_proto_description(alert), "old description"));
+        assert(streq(fty_proto_metadata(alert), ""));
+        fty_proto_destroy(&alert);
 
-        log_debug("s_string_encode/decode: OK");
+        log_debug("s_value_codec: OK");
     }
 
     //  ************************************
@@ -714,6 +1130,42 @@ alerts_utils_test(bool verbose) {
     assert(is_acknowledge_request_state(NULL) == 0);
     log_debug("is_acknowledge_request_state: OK");
 
+    //  ********************************************
+    //  *****   alert_state / alert_severity   *****
+    //  ********************************************
+    {
+        const char *states[] = { "ACTIVE", "ACK-WIP", "ACK-IGNORE", "ACK-PAUSE",
+            "ACK-SILENCE", "RESOLVED", "ALL", "ALL-ACTIVE" };
+        for (const char *state : states) {
+            alert_state_t id = alert_state_from_string(state);
+            assert(id != ALERT_STATE_UNKNOWN);
+            assert(streq(alert_state_string(id), state));
+            assert(alert_state_is_alert(id) == is_alert_state(state));
+            assert(alert_state_is_acknowledge(id) == is_acknowledge_state(state));
+        }
+        assert(alert_state_from_string(NULL) == ALERT_STATE_UNKNOWN);
+        assert(alert_state_from_string("") == ALERT_STATE_UNKNOWN);
+        assert(alert_state_from_string("active") == ALERT_STATE_UNKNOWN);
+        assert(alert_state_string(ALERT_STATE_UNKNOWN) == NULL);
+        assert(alert_state_string((alert_state_t) 42) == NULL);
+
+        assert(alert_state_included(ALERT_STATE_ALL_ACTIVE, ALERT_STATE_ACK_PAUSE) == 1);
+        assert(alert_state_included(ALERT_STATE_ALL_ACTIVE, ALERT_STATE_RESOLVED) == 0);
+        assert(alert_state_included(ALERT_STATE_ALL, ALERT_STATE_UNKNOWN) == 0);
+        assert(alert_state_included(ALERT_STATE_UNKNOWN, ALERT_STATE_ACTIVE) == 0);
+
+        const char *severities[] = { "INFO", "WARNING", "CRITICAL" };
+        for (const char *severity : severities) {
+            alert_severity_t id = alert_severity_from_string(severity);
+            assert(id != ALERT_SEVERITY_UNKNOWN);
+            assert(streq(alert_severity_string(id), severity));
+        }
+        assert(alert_severity_from_string("high") == ALERT_SEVERITY_UNKNOWN);
+        assert(alert_severity_from_string(NULL) == ALERT_SEVERITY_UNKNOWN);
+        assert(alert_severity_string(ALERT_SEVERITY_UNKNOWN) == NULL);
+        log_debug("alert_state / alert_severity: OK");
+    }
+
     //  **************************
     //  *****   alert_new    *****
     //  **************************
@@ -1677,6 +2129,199 @@ alerts_utils_test(bool verbose) {
         zsys_file_delete ("./test_state_file");
     }
 
+    // ZPL state file is still loaded
+    {
+        zlistx_t *alerts = zlistx_new ();
+        assert (alerts);
+        zlistx_set_destructor (alerts, (czmq_destructor *) fty_proto_destroy);
+        zlistx_set_duplicator (alerts, (czmq_duplicator *) fty_proto_dup);
+        zlist_t *actions = zlist_new ();
+        zlist_autofree (actions);
+        zlist_append (actions, (void *) ACTION_EMAIL);
+        fty_proto_t *alert = alert_new ("Rule1", "Element1", "ACTIVE", "high", "ŽlUťOUčKý kůň", 1, &actions, 0);
+        assert (alert);
+        zlistx_add_end (alerts, alert);
+        // duplicate is loaded once
+        zlistx_add_end (alerts, alert);
+        fty_proto_destroy (&alert);
+        assert (alert_save_state_zpl (alerts, ".", "test_state_file_zpl") == 0);
+        // saved alerts are left as they were
+        assert (streq (fty_proto_description ((fty_proto_t *) zlistx_first (alerts)), "ŽlUťOUčKý kůň"));
+        zlistx_destroy (&alerts);
+
+        alerts = zlistx_new ();
+        assert (alerts);
+        zlistx_set_destructor (alerts, (czmq_destructor *) fty_proto_destroy);
+        zlistx_set_duplicator (alerts, (czmq_duplicator *) fty_proto_dup);
+        assert (alert_load_state (alerts, ".", "test_state_file_zpl") == 0);
+        assert (zlistx_size (alerts) == 1);
+        fty_proto_t *cursor = (fty_proto_t *) zlistx_first (alerts);
+        assert (streq (fty_proto_rule (cursor), "Rule1"));
+        assert (streq (fty_proto_description (cursor), "ŽlUťOUčKý kůň"));
+        assert (streq (fty_proto_action_first (cursor), ACTION_EMAIL));
+        zlistx_destroy (&alerts);
+        zsys_file_delete ("./test_state_file_zpl");
+        zsys_file_delete ("./test_state_file_zpl.prev");
+    }
+
+    // corrupted state file, the previous generation is loaded
+    {
+        zlistx_t *alerts = zlistx_new ();
+        assert (alerts);
+        zlistx_set_destructor (alerts, (czmq_destructor *) fty_proto_destroy);
+        zlistx_set_duplicator (alerts, (czmq_duplicator *) fty_proto_dup);
+        for (int i = 0; i < 2; i++) {
+            zlist_t *actions = zlist_new ();
+            zlist_autofree (actions);
+            fty_proto_t *alert = alert_new ("Rule1", i ? "Element2" : "Element1", "ACTIVE", "high", "xyz", 1, &actions, 0);
+            zlistx_add_end (alerts, alert);
+            fty_proto_destroy (&alert);
+        }
+        // flip a byte of the state file
+        auto corrupt = [] () {
+            FILE *file = fopen ("./test_state_file_gen", "r+b");
+            assert (file);
+            fseek (file, 20, SEEK_SET);
+            int byte = fgetc (file);
+            fseek (file, 20, SEEK_SET);
+            fputc (byte ^ 0xff, file);
+            fclose (file);
+        };
+        zlistx_t *loaded = zlistx_new ();
+        zlistx_set_destructor (loaded, (czmq_destructor *) fty_proto_destroy);
+
+        // ZPL
+        assert (alert_save_state_zpl (alerts, ".", "test_state_file_gen") == 0);
+        zlistx_last (alerts);
+        zlistx_delete (alerts, zlistx_cursor (alerts));
+        assert (alert_save_state_zpl (alerts, ".", "test_state_file_gen") == 0);
+        assert (zsys_file_exists ("./test_state_file_gen.prev"));
+        assert (!zsys_file_exists ("./test_state_file_gen" STATE_TEMPORARY_SUFFIX));
+        assert (alert_load_state (loaded, ".", "test_state_file_gen") == 0);
+        assert (zlistx_size (loaded) == 1);
+        zlistx_purge (loaded);
+        corrupt ();
+        assert (alert_load_state (loaded, ".", "test_state_file_gen") == 0);
+        assert (zlistx_size (loaded) == 2);
+        zlistx_purge (loaded);
+
+        // image
+        assert (alert_save_state (alerts, ".", "test_state_file_gen", false) == 0);
+        assert (alert_load_state (loaded, ".", "test_state_file_gen") == 0);
+        assert (zlistx_size (loaded) == 1);
+        zlistx_purge (loaded);
+        corrupt ();
+        // previous generation is the corrupted ZPL file
+        assert (alert_load_state (loaded, ".", "test_state_file_gen") == -1);
+        assert (zlistx_size (loaded) == 0);
+
+        // failed install leaves the state file in place
+        assert (alert_state_install (".", "test_state_file_gen") == -1);
+        assert (zsys_file_exists ("./test_state_file_gen"));
+
+        zlistx_destroy (&loaded);
+        zlistx_destroy (&alerts);
+        zsys_file_delete ("./test_state_file_gen");
+        zsys_file_delete ("./test_state_file_gen.prev");
+    }
+
+    // legacy state file with records longer than 255 bytes
+    {
+        std::string description (1000, 'x');
+        zchunk_t *state = zchunk_new (NULL, 0);
+        for (int i = 0; i < 3; i++) {
+            zlist_t *actions = zlist_new ();
+            zlist_autofree (actions);
+            char element [32];
+            snprintf (element, sizeof (element), "ups-%d", i);
+            fty_proto_t *alert = alert_new ("Rule1", element, "ACTIVE", "high", description.c_str (), i, &actions, 0);
+            zmsg_t *msg = fty_proto_encode (&alert);
+            assert (msg);
+#if CZMQ_VERSION_MAJOR == 3
+            byte *buffer = NULL;
+            uint64_t size = zmsg_encode (msg, &buffer);
+            zframe_t *frame = zframe_new (buffer, size);
+            free (buffer);
+#else
+            zframe_t *frame = zmsg_encode (msg);
+            uint64_t size = zframe_size (frame);
+#endif
+            zmsg_destroy (&msg);
+            assert (size > 255);
+            zchunk_extend (state, &size, sizeof (size));
+            zchunk_extend (state, zframe_data (frame), zframe_size (frame));
+            zframe_destroy (&frame);
+        }
+        zfile_t *file = zfile_new (".", "test_state_file_legacy");
+        assert (file && zfile_output (file) == 0);
+        assert (zchunk_write (state, zfile_handle (file)) == 0);
+        zfile_destroy (&file);
+        zchunk_destroy (&state);
+
+        zlistx_t *alerts = zlistx_new ();
+        zlistx_set_destructor (alerts, (czmq_destructor *) fty_proto_destroy);
+        assert (alert_load_state (alerts, ".", "test_state_file_legacy") == 0);
+        assert (zlistx_size (alerts) == 3);
+        assert (streq (fty_proto_description ((fty_proto_t *) zlistx_last (alerts)), description.c_str ()));
+        zlistx_destroy (&alerts);
+        zsys_file_delete ("./test_state_file_legacy");
+    }
+
+    // large state image is decoded in parallel, in order and without duplicates
+    {
+        zlistx_t *alerts = zlistx_new ();
+        assert (alerts);
+        zlistx_set_destructor (alerts, (czmq_destructor *) fty_proto_destroy);
+        for (int i = 0; i < 10000; i++) {
+            zlist_t *actions = zlist_new ();
+            zlist_autofree (actions);
+            char element [32];
+            // last alert repeats the first one
+            snprintf (element, sizeof (element), "ups-%d", i % 9999);
+            zlistx_add_end (alerts, alert_new ("Rule1", element, "ACTIVE", "high", "xyz", i, &actions, 0));
+        }
+        assert (alert_save_state (alerts, ".", "test_state_file_parallel", false) == 0);
+        zlistx_purge (alerts);
+
+        int64_t start = zclock_mono ();
+        assert (alert_load_state (alerts, ".", "test_state_file_parallel") == 0);
+        if (verbose)
+            log_info ("10000 alerts loaded from the state image in %" PRIi64 " ms", zclock_mono () - start);
+        assert (zlistx_size (alerts) == 9999);
+        uint64_t time = 0;
+        for (fty_proto_t *cursor = (fty_proto_t *) zlistx_first (alerts); cursor;
+                cursor = (fty_proto_t *) zlistx_next (alerts))
+            assert (fty_proto_time (cursor) == time++);
+        zlistx_destroy (&alerts);
+        zsys_file_delete ("./test_state_file_parallel");
+    }
+
+    // startup time with a large ZPL state file
+    if (verbose) {
+        const int count = 60000;
+        zlistx_t *alerts = zlistx_new ();
+        assert (alerts);
+        zlistx_set_destructor (alerts, (czmq_destructor *) fty_proto_destroy);
+        for (int i = 0; i < count; i++) {
+            zlist_t *actions = zlist_new ();
+            zlist_autofree (actions);
+            zlist_append (actions, (void *) ACTION_EMAIL);
+            char element [32];
+            snprintf (element, sizeof (element), "ups-%d", i);
+            zlistx_add_end (alerts, alert_new ("Rule1", element, "ACTIVE", "high", "description", i, &actions, 0));
+        }
+        assert (alert_save_state_zpl (alerts, ".", "test_state_file_large") == 0);
+        zlistx_purge (alerts);
+
+        int64_t start = zclock_mono ();
+        assert (alert_load_state (alerts, ".", "test_state_file_large") == 0);
+        assert (zlistx_size (alerts) == (size_t) count);
+        log_info ("%d alerts loaded from the ZPL state file in %" PRIi64 " ms", count, zclock_mono () - start);
+        zlistx_destroy (&alerts);
+        zsys_file_delete ("./test_state_file_large");
+        zsys_file_delete ("./test_state_file_large.prev");
+    }
+
     // Test case #2:
     //  file does not exist
     {
@@ -1688,6 +2333,23 @@ alerts_utils_test(bool verbose) {
         assert(rv == -1);
         zlistx_destroy(&alerts);
     }
+    //  alert_crc32c
+    {
+        // check value of CRC-32C
+        assert (alert_crc32c (0, "123456789", 9) == 0xE3069283);
+        assert (alert_crc32c (0, NULL, 0) == 0);
+        // continued over parts
+        uint32_t crc = alert_crc32c (0, "1234", 4);
+        assert (alert_crc32c (crc, "56789", 5) == 0xE3069283);
+        // same over words and bytes at any alignment
+        char buffer [1000];
+        for (size_t i = 0; i < sizeof (buffer); i++)
+            buffer [i] = (char) (i * 7);
+        uint32_t whole = alert_crc32c (0, buffer, sizeof (buffer));
+        for (size_t split = 1; split < 20; split++)
+            assert (alert_crc32c (alert_crc32c (0, buffer, split), buffer + split, sizeof (buffer) - split) == whole);
+    }
+
     // State file with old format
     {
     zlistx_t *alerts = zlistx_new ();
@@ -28,17 +28,123 @@ extern "C" {
 
 #define ACTION_EMAIL  "EMAIL"
 #define ACTION_SMS    "SMS"
-    
-// load alert state from disk
+
+// alert states and rfc-alerts-list request states
+typedef enum {
+    ALERT_STATE_UNKNOWN = 0,
+    ALERT_STATE_ACTIVE,
+    ALERT_STATE_ACK_WIP,
+    ALERT_STATE_ACK_IGNORE,
+    ALERT_STATE_ACK_PAUSE,
+    ALERT_STATE_ACK_SILENCE,
+    ALERT_STATE_RESOLVED,
+    // rfc-alerts-list request states only
+    ALERT_STATE_ALL,
+    ALERT_STATE_ALL_ACTIVE
+} alert_state_t;
+
+// alert severities known to the agent, anything else is ALERT_SEVERITY_UNKNOWN
+typedef enum {
+    ALERT_SEVERITY_UNKNOWN = 0,
+    ALERT_SEVERITY_INFO,
+    ALERT_SEVERITY_WARNING,
+    ALERT_SEVERITY_CRITICAL
+} alert_severity_t;
+
+// parse 'state' (case sensitive)
+// returns ALERT_STATE_UNKNOWN if 'state' is NULL or not a valid state
+FTY_ALERT_LIST_EXPORT alert_state_t
+    alert_state_from_string (const char *state);
+
+// protocol name of 'state', NULL for ALERT_STATE_UNKNOWN
+FTY_ALERT_LIST_EXPORT const char *
+    alert_state_string (alert_state_t state);
+
+// parse 'severity' (case sensitive)
+// returns ALERT_SEVERITY_UNKNOWN if 'severity' is NULL or not a known severity
+FTY_ALERT_LIST_EXPORT alert_severity_t
+    alert_severity_from_string (const char *severity);
+
+// protocol name of 'severity', NULL for ALERT_SEVERITY_UNKNOWN
+FTY_ALERT_LIST_EXPORT const char *
+    alert_severity_string (alert_severity_t severity);
+
+// is 'state' an acknowledge state?
+// 1 - Yes, 0 - No
+FTY_ALERT_LIST_EXPORT int
+    alert_state_is_acknowledge (alert_state_t state);
+
+// is 'state' a state an alert can be in?
+// 1 - Yes, 0 - No
+FTY_ALERT_LIST_EXPORT int
+    alert_state_is_alert (alert_state_t state);
+
+// Is alert state included in or equal to rfc-alerts-list request state?
+// 1 - Yes, 0 - No
+FTY_ALERT_LIST_EXPORT int
+    alert_state_included (alert_state_t list_request_state, alert_state_t alert);
+
+// aux of alerts in the state file only: wall-clock time (s) when ACTIVE
+// alert times out, and of its last publish on ALERTS
+#define STATE_AUX_DEADLINE      "state.deadline"
+#define STATE_AUX_LAST_SENT     "state.last_sent"
+
+// aux of alerts in ZPL state files only: fields of the alert escaped by
+// alert_state_escape (), STATE_ESCAPED_* flags
+#define STATE_AUX_ESCAPED           "state.escaped"
+#define STATE_ESCAPED_DESCRIPTION   1
+#define STATE_ESCAPED_METADATA      2
+
+// escape description and metadata of 'alert' for a ZPL state file, where
+// zconfig can't keep them as they are; plain ASCII values are left as they are
+FTY_ALERT_LIST_EXPORT void
+    alert_state_escape (fty_proto_t *alert);
+
+// undo alert_state_escape () on 'alert' read from a ZPL state file (see
+// alert_zpl_reader), including files of older versions
+FTY_ALERT_LIST_EXPORT void
+    alert_state_unescape (fty_proto_t *alert);
+
+// load alert state from disk, with changes from its journal (see alert_journal);
+// the previous generation of the state file is used if the current one is
+// corrupted
 // 0 - success, -1 - error
 FTY_ALERT_LIST_EXPORT int
     alert_load_state (zlistx_t *alerts, const char *path, const char *filename);
 
-// save alert state to disk
+// set most threads decoding a state file in alert_load_state (), 0 - default
+FTY_ALERT_LIST_EXPORT void
+    alert_load_set_threads (size_t threads);
+
+// save alert state to disk, as a state image (see alert_image);
+// 'alerts' are only read
 // 0 - success, -1 - error
 FTY_ALERT_LIST_EXPORT int
     alert_save_state (zlistx_t *alerts, const char *path, const char *filename, bool verbose);
 
+// save alert state to disk in ZPL format, as done by older versions
+// 0 - success, -1 - error
+FTY_ALERT_LIST_EXPORT int
+    alert_save_state_zpl (zlistx_t *alerts, const char *path, const char *filename);
+
+// write 'size' bytes of 'data' to state file 'filename' in 'path' safely:
+// data go to a temporary file, synced and installed by alert_state_install ()
+// 0 - success, -1 - error
+FTY_ALERT_LIST_EXPORT int
+    alert_state_write (const char *path, const char *filename, const void *data, size_t size);
+
+// state files are written to 'filename' STATE_TEMPORARY_SUFFIX first
+#define STATE_TEMPORARY_SUFFIX ".tmp"
+
+// install temporary file of state file 'filename' in 'path', written and
+// synced: the state file is kept as 'filename'.prev for alert_load_state ()
+// by a hard link, then replaced by a rename, so that 'filename' always names
+// a complete file; the directory is synced. The temporary file is removed
+// on error.
+// 0 - success, -1 - error
+FTY_ALERT_LIST_EXPORT int
+    alert_state_install (const char *path, const char *filename);
+
 // create new alert
 // returns new alert on success, NULL on failure
 FTY_ALERT_LIST_EXPORT fty_proto_t*
@@ -92,6 +198,12 @@ FTY_ALERT_LIST_EXPORT int
 FTY_ALERT_LIST_EXPORT int
     is_acknowledge_request_state (const char *state);
 
+// CRC-32C (Castagnoli) of 'size' bytes of 'data', continuing 'crc'
+// (0 to start), for integrity checks of files written by the agent;
+// uses the CRC-32C instruction of the CPU where available
+FTY_ALERT_LIST_EXPORT uint32_t
+    alert_crc32c (uint32_t crc, const void *data, size_t size);
+
 //  Self test of this class
 FTY_ALERT_LIST_EXPORT void
     alerts_utils_test (bool verbose);
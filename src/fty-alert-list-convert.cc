@@ -1,5 +1,5 @@
 /*  =========================================================================
-    fty_alert_list_convert - Converts bios_proto state file to fty_proto state.
+    fty_alert_list_convert - Converts state files between formats.
 
     Copyright (C) 2014 - 2020 Eaton
 
@@ -21,198 +21,770 @@
 
 /*
 @header
-    fty_alert_list_convert - Converts bios_proto state file to fty_proto state.
+    fty_alert_list_convert - Converts state files between formats.
 @discuss
+    Formats of state files:
+
+        bios    - bios_proto alerts, each prefixed by its size (uint64_t)
+        legacy  - fty_proto alerts, each prefixed by its size (uint64_t)
+        zpl     - ZPL, as written by alert_save_state_zpl ()
+        image   - binary image, as written by alert_image_save ()
+
+    The input file is mapped or read line by line and the output is written
+    one alert at a time through a buffer, so memory use does not grow with
+    the size of the file. Records that can't be decoded are skipped and
+    reported, a truncated tail ends the input. The output is written to a
+    temporary file and renamed over the target once complete.
+
+    While converting, the file can be compacted: later records of an alert
+    are dropped (the agent ignores them when loading), as are RESOLVED
+    alerts older than a number of days or beyond a number of the newest
+    ones. The cap takes a first pass over the file, which keeps only the
+    times of the newest RESOLVED alerts in memory.
 @end
 */
 
+#include <ctype.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <unordered_set>
+#include <vector>
 #include "fty_alert_list_classes.h"
 
-int
-convert_file (const char *file_name, const char *old_path, const char *new_path)
-{
-    assert (file_name);
-    assert (old_path);
-    assert (new_path);
+// size of output buffers
+#define CONVERT_BUFFER_SIZE (1 << 20)
 
-    log_debug ("Converting state_file %s/%s and saving it to %s/%s.", old_path, file_name, new_path, file_name);
+typedef enum {
+    FORMAT_AUTO,
+    FORMAT_BIOS,
+    FORMAT_LEGACY,
+    FORMAT_ZPL,
+    FORMAT_IMAGE,
+    FORMAT_UNKNOWN
+} format_t;
 
-    zfile_t *file = zfile_new (old_path, file_name);
-    if (!file) {
-        log_error ("zfile_new (path = '%s', file = '%s') failed.", old_path, file_name);
-        return -1;
-    }
-    if (!zfile_is_regular (file)) {
-        log_error ("zfile_is_regular () == false");
-        zfile_close (file);
-        zfile_destroy (&file);
-        return -1;
-    }
-    if (zfile_input (file) == -1) {
-        zfile_close (file);
-        zfile_destroy (&file);
-        log_error ("zfile_input () failed; filename = '%s'", zfile_filename (file, NULL));
-        return -1;
-    }
+static format_t
+s_format_from_string (const char *format)
+{
+    if (streq (format, "auto"))
+        return FORMAT_AUTO;
+    if (streq (format, "bios"))
+        return FORMAT_BIOS;
+    if (streq (format, "legacy"))
+        return FORMAT_LEGACY;
+    if (streq (format, "zpl"))
+        return FORMAT_ZPL;
+    if (streq (format, "image"))
+        return FORMAT_IMAGE;
+    return FORMAT_UNKNOWN;
+}
 
-    off_t cursize = zfile_cursize (file);
-    if (cursize == 0) {
-        log_debug ("state file '%s' is empty", zfile_filename (file, NULL));
-        zfile_close (file);
-        zfile_destroy (&file);
-        return 0;
+static const char *
+s_format_name (format_t format)
+{
+    switch (format) {
+        case FORMAT_BIOS:   return "bios";
+        case FORMAT_LEGACY: return "legacy";
+        case FORMAT_ZPL:    return "zpl";
+        case FORMAT_IMAGE:  return "image";
+        default:            return "auto";
     }
+}
 
-    zchunk_t *chunk = zchunk_read (zfile_handle (file), cursize);
-    assert (chunk);
-    zframe_t *frame = zframe_new (zchunk_data (chunk), zchunk_size (chunk));
-    assert (frame);
-
-    zchunk_destroy (&chunk);
-
-    zfile_close (file);
-    zfile_destroy (&file);
-
-   /* Note: Protocol data uses 8-byte sized words, and zmsg_XXcode and file
-    * functions deal with platform-dependent unsigned size_t and signed off_t.
-    * The off_t is a difficult one to print portably, SO suggests casting to
-    * the intmax type and printing that :)
-    * https://stackoverflow.com/questions/586928/how-should-i-print-types-like-off-t-and-size-t
-    */
-    off_t offset = 0;
-    log_debug ("zfile_cursize == %jd", (intmax_t)cursize);
-
-    //chunk for new state file
-    zchunk_t *nchunk = zchunk_new (NULL, 0);
-    assert (nchunk);
-
-    while (offset < cursize) {
-        byte *prefix = zframe_data (frame) + offset;
-        byte *data = zframe_data (frame) + offset + sizeof (uint64_t);
-        offset += (uint64_t) *prefix +  sizeof (uint64_t);
-        log_debug ("prefix == %" PRIu64 "; offset = %jd ", (uint64_t ) *prefix, (intmax_t)offset);
-
+// decode message 'size' bytes at 'data'
+// returns new message, NULL if malformed
+static zmsg_t *
+s_message_decode (const byte *data, size_t size)
+{
 /* Note: the CZMQ_VERSION_MAJOR comparisons below actually assume versions
  * we know and care about - v3.0.2 (our legacy default, already obsoleted
  * by upstream), and v4.x that is in current upstream master. If the API
  * evolves later (incompatibly), these macros will need to be amended.
  */
-        zmsg_t *zmessage = NULL;
 #if CZMQ_VERSION_MAJOR == 3
-        zmessage = zmsg_decode (data, (size_t) *prefix);
+    return zmsg_decode ((byte *) data, size);
 #else
+    zframe_t *frame = zframe_new (data, size);
+    zmsg_t *zmessage = frame ? zmsg_decode (frame) : NULL;
+    zframe_destroy (&frame);
+    return zmessage;
+#endif
+}
+
+// convert bios_proto alert to fty_proto alert
+static fty_proto_t *
+s_bios_convert (bios_proto_t *balert)
+{
+    fty_proto_t *falert = fty_proto_new (FTY_PROTO_ALERT);
+    if (!falert)
+        return NULL;
+
+    fty_proto_set_time (falert, bios_proto_time (balert));
+    fty_proto_set_ttl (falert, (uint32_t) bios_proto_aux_number (balert, "ttl", 900));
+    fty_proto_set_rule (falert, "%s", bios_proto_rule (balert));
+    fty_proto_set_name (falert, "%s", bios_proto_element_src (balert));
+    fty_proto_set_state (falert, "%s", bios_proto_state (balert));
+    fty_proto_set_severity (falert, "%s", bios_proto_severity (balert));
+    fty_proto_set_description (falert, "%s", bios_proto_description (balert));
+    zlist_t *actions = zlist_new ();
+    zlist_autofree (actions);
+    if (NULL != bios_proto_action (balert)) {
+        char *old_actions = strdup (bios_proto_action (balert));
+        char *single_action = strtok (old_actions, "/|\\");
+        while (NULL != single_action) {
+            zlist_append (actions, single_action);
+            single_action = strtok (NULL, "/|\\");
+        }
+        free (old_actions);
+    }
+    fty_proto_set_action (falert, &actions);
+    if (NULL != actions)
+        zlist_destroy (&actions);
+    return falert;
+}
+
+//  --------------------------------------------------------------------------
+//  Readers of state files
+
+class s_reader {
+    public:
+        virtual ~s_reader () {}
+        // next alert of the file, NULL at the end
+        virtual fty_proto_t *next () = 0;
+        // number of records skipped
+        size_t skipped () const { return m_skipped; }
+        // the file ended in a torn record or its checksum does not match
+        bool damaged () const { return m_damaged; }
+    protected:
+        size_t m_skipped = 0;
+        bool m_damaged = false;
+};
+
+// bios and legacy files, mapped
+class s_prefixed_reader : public s_reader {
+    public:
+        s_prefixed_reader (const byte *data, size_t size, bool bios) :
+            m_data (data), m_size (size), m_bios (bios) {}
+
+        fty_proto_t *next () override
+        {
+            while (m_offset < m_size) {
+                uint64_t size;
+                if (m_size - m_offset < sizeof (size)) {
+                    s_torn ();
+                    break;
+                }
+                memcpy (&size, m_data + m_offset, sizeof (size));
+                if (size > m_size - m_offset - sizeof (size)) {
+                    s_torn ();
+                    break;
+                }
+                const byte *data = m_data + m_offset + sizeof (size);
+                m_offset += sizeof (size) + size;
+
+                fty_proto_t *alert = decode (data, (size_t) size, m_bios);
+                if (alert)
+                    return alert;
+                log_warning ("skipping malformed record at offset %zu", (size_t) (data - m_data) - sizeof (size));
+                m_skipped++;
+            }
+            return NULL;
+        }
+
+        // decode one record of 'size' bytes at 'data'
+        // returns new alert, NULL if the record is not an alert
+        static fty_proto_t *decode (const byte *data, size_t size, bool bios)
         {
-            zframe_t *fr = zframe_new (data, (size_t) *prefix);
-            zmessage = zmsg_decode (fr);
-            zframe_destroy (&fr);
+            zmsg_t *zmessage = s_message_decode (data, size);
+            if (!zmessage)
+                return NULL;
+            if (!bios) {
+                fty_proto_t *alert = fty_proto_decode (&zmessage);
+                if (alert && fty_proto_id (alert) != FTY_PROTO_ALERT)
+                    fty_proto_destroy (&alert);
+                return alert;
+            }
+            bios_proto_t *balert = bios_proto_decode (&zmessage);
+            fty_proto_t *alert = balert && bios_proto_id (balert) == BIOS_PROTO_ALERT ? s_bios_convert (balert) : NULL;
+            bios_proto_destroy (&balert);
+            return alert;
         }
-#endif
-        assert (zmessage);
-
-        bios_proto_t *balert = bios_proto_decode (&zmessage);
-        assert (balert);
-        fty_proto_t *falert = fty_proto_new (2);
-        assert (falert);
-
-        fty_proto_set_time (falert, bios_proto_time (balert));
-        fty_proto_set_ttl (falert, (uint32_t) bios_proto_aux_number (balert, "ttl", 900));
-        fty_proto_set_rule (falert, "%s", bios_proto_rule (balert));
-        fty_proto_set_name (falert, "%s", bios_proto_element_src (balert));
-        fty_proto_set_state (falert, "%s", bios_proto_state (balert));
-        fty_proto_set_severity (falert, "%s", bios_proto_severity (balert));
-        fty_proto_set_description (falert, "%s", bios_proto_description (balert));
-        zlist_t *actions = zlist_new ();
-        zlist_autofree(actions);
-        if (NULL != bios_proto_action (balert)) {
-            char *old_actions = strdup (bios_proto_action (balert));
-            char *single_action = strtok(old_actions, "/|\\");
-            while (NULL != single_action) {
-                zlist_append(actions, single_action);
-                single_action = strtok(NULL, "/|\\");
-            }
-        }
-        fty_proto_set_action (falert, &actions);
-
-        if (NULL != actions)
-            zlist_destroy (&actions);
-        bios_proto_destroy (&balert);
-
-        // --- save the data----
-        zmsg_t *zmsg = fty_proto_encode (&falert);
-        assert (zmsg);
-
-        uint64_t size = 0;  // Note: the zmsg_encode() and zframe_size()
-                            // below return a platform-dependent size_t,
-                            // but in protocol we use fixed uint64_t
-        assert ( sizeof(size_t) <= sizeof(uint64_t) );
-        zframe_t *nframe = NULL;
 
-#if CZMQ_VERSION_MAJOR == 3
+    private:
+        void s_torn ()
+        {
+            log_error ("state file is truncated, %zu bytes at offset %zu ignored", m_size - m_offset, m_offset);
+            m_skipped++;
+            m_damaged = true;
+            m_offset = m_size;
+        }
+
+        const byte *m_data;
+        size_t m_size;
+        size_t m_offset = 0;
+        bool m_bios;
+};
+
+class s_zpl_reader : public s_reader {
+    public:
+        explicit s_zpl_reader (alert_zpl_reader_t *reader) : m_reader (reader) {}
+        ~s_zpl_reader () { alert_zpl_reader_destroy (&m_reader); }
+
+        fty_proto_t *next () override
+        {
+            fty_proto_t *alert = alert_zpl_reader_next (m_reader);
+            if (alert)
+                alert_state_unescape (alert);
+            else {
+                m_skipped = alert_zpl_reader_skipped (m_reader);
+                if (alert_zpl_reader_verify (m_reader) == -1) {
+                    log_error ("checksum of the state file does not match");
+                    m_damaged = true;
+                }
+            }
+            return alert;
+        }
+
+    private:
+        alert_zpl_reader_t *m_reader;
+};
+
+class s_image_reader : public s_reader {
+    public:
+        explicit s_image_reader (alert_image_t *image) : m_image (image) {}
+        ~s_image_reader () { alert_image_destroy (&m_image); }
+
+        fty_proto_t *next () override
+        {
+            if (m_index >= alert_image_count (m_image))
+                return NULL;
+            return alert_image_decode (m_image, m_index++);
+        }
+
+    private:
+        alert_image_t *m_image;
+        size_t m_index = 0;
+};
+
+// detect format of 'size' bytes at 'data'
+static format_t
+s_format_detect (const byte *data, size_t size)
+{
+    if (size >= strlen (ALERT_IMAGE_MAGIC) && memcmp (data, ALERT_IMAGE_MAGIC, strlen (ALERT_IMAGE_MAGIC)) == 0)
+        return FORMAT_IMAGE;
+    uint64_t length;
+    if (size >= sizeof (length)) {
+        memcpy (&length, data, sizeof (length));
+        if (length <= size - sizeof (length)) {
+            fty_proto_t *alert = s_prefixed_reader::decode (data + sizeof (length), (size_t) length, false);
+            if (alert) {
+                fty_proto_destroy (&alert);
+                return FORMAT_LEGACY;
+            }
+            alert = s_prefixed_reader::decode (data + sizeof (length), (size_t) length, true);
+            if (alert) {
+                fty_proto_destroy (&alert);
+                return FORMAT_BIOS;
+            }
+        }
+    }
+    return FORMAT_ZPL;
+}
+
+//  --------------------------------------------------------------------------
+//  Writers of state files
+
+class s_writer {
+    public:
+        virtual ~s_writer () {}
+        // append alert, takes its ownership
+        // 0 - success, -1 - error
+        virtual int add (fty_proto_t **alert_p) = 0;
+        // complete the file
+        // 0 - success, -1 - error
+        virtual int close () = 0;
+};
+
+// legacy and ZPL files, buffered, renamed over the target when closed
+class s_file_writer : public s_writer {
+    public:
+        s_file_writer (const char *path, const char *filename)
+        {
+            m_path = path;
+            m_name = filename;
+            m_filename = zsys_sprintf ("%s/%s", path, filename);
+            m_temporary = zsys_sprintf ("%s/%s%s", path, filename, STATE_TEMPORARY_SUFFIX);
+            m_file = m_temporary ? fopen (m_temporary, "we") : NULL;
+            if (m_file)
+                setvbuf (m_file, NULL, _IOFBF, CONVERT_BUFFER_SIZE);
+            else
+                log_error ("cannot create %s: %s", m_temporary ? m_temporary : filename, strerror (errno));
+        }
+
+        ~s_file_writer ()
         {
+            if (m_file) {
+                // not closed, discard
+                fclose (m_file);
+                unlink (m_temporary);
+            }
+            zstr_free (&m_filename);
+            zstr_free (&m_temporary);
+        }
+
+        bool valid () const { return m_file != NULL; }
+
+        int close () override
+        {
+            if (!m_file)
+                return -1;
+            bool written = !m_failed && trailer () == 0 &&
+                fflush (m_file) == 0 && fsync (fileno (m_file)) == 0;
+            if (fclose (m_file) != 0)
+                written = false;
+            m_file = NULL;
+            if (!written) {
+                log_error ("cannot write %s: %s", m_filename, strerror (errno));
+                unlink (m_temporary);
+                return -1;
+            }
+            return alert_state_install (m_path.c_str (), m_name.c_str ());
+        }
+
+    protected:
+        // write 'size' bytes at 'data'
+        int write (const void *data, size_t size)
+        {
+            if (m_failed || (size && fwrite (data, 1, size, m_file) != size)) {
+                m_failed = true;
+                return -1;
+            }
+            return 0;
+        }
+
+        // write what ends the file
+        virtual int trailer () { return 0; }
+
+    private:
+        std::string m_path;
+        std::string m_name;
+        char *m_filename;
+        char *m_temporary;
+        FILE *m_file;
+        bool m_failed = false;
+};
+
+class s_legacy_writer : public s_file_writer {
+    public:
+        using s_file_writer::s_file_writer;
+
+        int add (fty_proto_t **alert_p) override
+        {
+            zmsg_t *zmsg = fty_proto_encode (alert_p);
+            if (!zmsg)
+                return -1;
+            // Note: the zmsg_encode() and zframe_size() below return a
+            // platform-dependent size_t, but in protocol we use fixed uint64_t
+            uint64_t size = 0;
+            int rv = -1;
+#if CZMQ_VERSION_MAJOR == 3
             byte *buffer = NULL;
             size = zmsg_encode (zmsg, &buffer);
-
-            assert (buffer);
-            assert (size > 0);
-            nframe = zframe_new (buffer, size);
+            if (buffer && size > 0 && write (&size, sizeof (size)) == 0)
+                rv = write (buffer, size);
             free (buffer);
-            buffer = NULL;
-        }
 #else
-        nframe = zmsg_encode (zmsg);
-        size = zframe_size (nframe);
+            zframe_t *frame = zmsg_encode (zmsg);
+            size = frame ? zframe_size (frame) : 0;
+            if (size > 0 && write (&size, sizeof (size)) == 0)
+                rv = write (zframe_data (frame), size);
+            zframe_destroy (&frame);
 #endif
-        zmsg_destroy (&zmsg);
-        assert (nframe);
-        assert (size > 0);
-
-        // prefix
-// FIXME: originally this was for uint64_t, should it be sizeof (size) instead?
-// Also is usage of uint64_t here really warranted (e.g. dictated by protocol)?
-        zchunk_extend (nchunk, (const void *) &size, sizeof (uint64_t));
-        // data
-        zchunk_extend (nchunk, (const void *) zframe_data (nframe), size);
-
-        zframe_destroy (&nframe);
-        fty_proto_destroy (&falert);
+            zmsg_destroy (&zmsg);
+            return rv;
+        }
+};
+
+class s_zpl_writer : public s_file_writer {
+    public:
+        using s_file_writer::s_file_writer;
+
+        int add (fty_proto_t **alert_p) override
+        {
+            // same bytes as alert_save_state_zpl () writes for the alert
+            alert_state_escape (*alert_p);
+            zconfig_t *root = zconfig_new ("root", NULL);
+            fty_proto_zpl (*alert_p, root);
+            fty_proto_destroy (alert_p);
+            zchunk_t *chunk = zconfig_chunk_save (root);
+            zconfig_destroy (&root);
+            if (!chunk)
+                return -1;
+            m_crc = alert_crc32c (m_crc, zchunk_data (chunk), zchunk_size (chunk));
+            int rv = write (zchunk_data (chunk), zchunk_size (chunk));
+            zchunk_destroy (&chunk);
+            return rv;
+        }
+
+    protected:
+        int trailer () override
+        {
+            char trailer [32];
+            snprintf (trailer, sizeof (trailer), "%s0x%08x\n", ALERT_ZPL_CHECKSUM_TRAILER, m_crc);
+            return write (trailer, strlen (trailer));
+        }
+
+    private:
+        uint32_t m_crc = 0;
+};
+
+class s_image_writer : public s_writer {
+    public:
+        explicit s_image_writer (alert_image_writer_t *writer) : m_writer (writer) {}
+        ~s_image_writer () { alert_image_writer_destroy (&m_writer); }
+
+        int add (fty_proto_t **alert_p) override
+        {
+            int rv = alert_image_writer_add (m_writer, *alert_p);
+            fty_proto_destroy (alert_p);
+            return rv;
+        }
+
+        int close () override { return alert_image_writer_close (m_writer); }
+
+    private:
+        alert_image_writer_t *m_writer;
+};
+
+//  --------------------------------------------------------------------------
+//  Compaction
+
+// what to drop while converting
+typedef struct {
+    bool dedupe;                // later records of an alert already converted
+    uint64_t max_age;           // RESOLVED alerts older than this [s], 0 - none
+    size_t max_resolved;        // RESOLVED alerts but this many newest, 0 - none
+} compact_t;
+
+class s_compactor {
+    public:
+        explicit s_compactor (const compact_t &compact) : m_compact (compact)
+        {
+            if (m_compact.max_age)
+                m_oldest = (uint64_t) time (NULL) - std::min ((uint64_t) time (NULL), m_compact.max_age);
+        }
+
+        // first pass over the file, needed when the number of RESOLVED
+        // alerts is capped: find time of the newest alerts to keep
+        bool first_pass () const { return m_compact.max_resolved > 0; }
+
+        void scan (fty_proto_t *alert)
+        {
+            if (!s_resolved (alert) || fty_proto_time (alert) < m_oldest || !s_first (m_scanned, alert))
+                return;
+            // min-heap of times of the newest RESOLVED alerts
+            m_newest.push_back (fty_proto_time (alert));
+            std::push_heap (m_newest.begin (), m_newest.end (), std::greater<uint64_t> ());
+            if (m_newest.size () > m_compact.max_resolved) {
+                std::pop_heap (m_newest.begin (), m_newest.end (), std::greater<uint64_t> ());
+                m_newest.pop_back ();
+            }
+        }
+
+        void scanned ()
+        {
+            // cap not reached otherwise
+            if (m_newest.size () == m_compact.max_resolved) {
+                // RESOLVED alerts newer than the oldest kept one are kept,
+                // as many as fit the cap of those as old
+                m_capping = true;
+                m_threshold = m_newest.front ();
+                m_ties = (size_t) std::count (m_newest.begin (), m_newest.end (), m_threshold);
+            }
+            std::unordered_set<const char *> ().swap (m_scanned);
+            std::vector<uint64_t> ().swap (m_newest);
+        }
+
+        // alert is to be converted
+        bool keep (fty_proto_t *alert)
+        {
+            if ((m_compact.dedupe || first_pass ()) && !s_first (m_kept, alert)) {
+                m_duplicates++;
+                return false;
+            }
+            if (!s_resolved (alert))
+                return true;
+            if (fty_proto_time (alert) < m_oldest) {
+                m_expired++;
+                return false;
+            }
+            if (!m_capping || fty_proto_time (alert) > m_threshold)
+                return true;
+            if (fty_proto_time (alert) == m_threshold && m_ties > 0) {
+                m_ties--;
+                return true;
+            }
+            m_capped++;
+            return false;
+        }
+
+        size_t duplicates () const { return m_duplicates; }
+        size_t expired () const { return m_expired; }
+        size_t capped () const { return m_capped; }
+
+    private:
+        static bool s_resolved (fty_proto_t *alert)
+        {
+            return alert_state_from_string (fty_proto_state (alert)) == ALERT_STATE_RESOLVED;
+        }
+
+        // first record of the alert in 'identities'
+        static bool s_first (std::unordered_set<const char *> &identities, fty_proto_t *alert)
+        {
+            const char *identity = alert_intern_identity (fty_proto_rule (alert), fty_proto_name (alert));
+            return !identity || identities.insert (identity).second;
+        }
+
+        compact_t m_compact;
+        uint64_t m_oldest = 0;          // time of the oldest RESOLVED alert kept
+        bool m_capping = false;         // more RESOLVED alerts than the cap
+        uint64_t m_threshold = 0;       // time of the oldest RESOLVED alert kept by the cap
+        size_t m_ties = 0;              // RESOLVED alerts of m_threshold time to keep
+        std::unordered_set<const char *> m_scanned;
+        std::unordered_set<const char *> m_kept;
+        std::vector<uint64_t> m_newest;
+        size_t m_duplicates = 0;
+        size_t m_expired = 0;
+        size_t m_capped = 0;
+};
+
+//  --------------------------------------------------------------------------
+
+// open reader of state file 'file_name' in 'path' of format 'from' mapped
+// at 'data' of 'size' bytes
+// returns new reader, NULL if the file is not a valid state file
+static s_reader *
+s_reader_new (format_t from, const void *data, size_t size, const char *path, const char *file_name)
+{
+    if (from == FORMAT_BIOS || from == FORMAT_LEGACY)
+        return new s_prefixed_reader ((const byte *) data, size, from == FORMAT_BIOS);
+    if (from == FORMAT_ZPL) {
+        alert_zpl_reader_t *zpl = alert_zpl_reader_new (path, file_name);
+        return zpl ? new s_zpl_reader (zpl) : NULL;
     }
+    alert_image_t *image = alert_image_open (path, file_name);
+    return image ? new s_image_reader (image) : NULL;
+}
 
-    zfile_t *nfile = zfile_new (new_path, file_name);
-    if (!nfile) {
-        log_error ("zfile_new (path = '%s', file = '%s') failed.", new_path, file_name);
-        return -1;
+// open writer of state file 'file_name' in 'path' of format 'to'
+// returns new writer, NULL if the file can't be created
+static s_writer *
+s_writer_new (format_t to, const char *path, const char *file_name)
+{
+    if (to == FORMAT_IMAGE) {
+        alert_image_writer_t *image = alert_image_writer_new (path, file_name);
+        return image ? new s_image_writer (image) : NULL;
     }
+    s_file_writer *writer = to == FORMAT_ZPL ?
+        (s_file_writer *) new s_zpl_writer (path, file_name) :
+        (s_file_writer *) new s_legacy_writer (path, file_name);
+    if (writer->valid ())
+        return writer;
+    delete writer;
+    return NULL;
+}
 
-    int rv = zfile_output (nfile);
-    assert (rv != -1);
+// convert state file 'file_name' in 'old_path' of format 'from' to
+// 'new_path' in format 'to', dropping alerts as 'compact' says
+// 0 - success, -1 - error
+int
+convert_file (const char *file_name, const char *old_path, const char *new_path,
+    format_t from, format_t to, const compact_t &compact)
+{
+    assert (file_name);
+    assert (old_path);
+    assert (new_path);
 
-    if (zchunk_write (nchunk, zfile_handle (nfile)) == -1) {
-        log_error ("zchunk_write () failed.");
+    char *state_file = zsys_sprintf ("%s/%s", old_path, file_name);
+    int fd = state_file ? open (state_file, O_RDONLY | O_CLOEXEC) : -1;
+    struct stat st;
+    if (fd == -1 || fstat (fd, &st) == -1 || !S_ISREG (st.st_mode)) {
+        log_error ("cannot read state file %s: %s", state_file, strerror (errno));
+        if (fd != -1)
+            close (fd);
+        zstr_free (&state_file);
+        return -1;
+    }
+    size_t size = (size_t) st.st_size;
+    void *data = NULL;
+    if (size > 0) {
+        data = mmap (NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            log_error ("cannot map state file %s: %s", state_file, strerror (errno));
+            close (fd);
+            zstr_free (&state_file);
+            return -1;
+        }
+        madvise (data, size, MADV_SEQUENTIAL);
+    }
+    close (fd);
+
+    if (from == FORMAT_AUTO)
+        from = s_format_detect ((const byte *) data, size);
+    log_debug ("converting %s state file %s to %s state file %s/%s",
+        s_format_name (from), state_file, s_format_name (to), new_path, file_name);
+
+    s_compactor compactor (compact);
+    s_reader *reader = s_reader_new (from, data, size, old_path, file_name);
+    if (reader && compactor.first_pass ()) {
+        fty_proto_t *alert;
+        while ((alert = reader->next ())) {
+            compactor.scan (alert);
+            fty_proto_destroy (&alert);
+        }
+        compactor.scanned ();
+        delete reader;
+        if (data)
+            madvise (data, size, MADV_SEQUENTIAL);
+        reader = s_reader_new (from, data, size, old_path, file_name);
     }
 
-    zchunk_destroy (&nchunk);
-    zfile_close (nfile);
-    zfile_destroy (&nfile);
+    int rv = -1;
+    s_writer *writer = NULL;
+    if (!reader)
+        log_error ("%s is not a valid %s state file", state_file, s_format_name (from));
+    else
+    if ((writer = s_writer_new (to, new_path, file_name))) {
+        size_t converted = 0;
+        rv = 0;
+        fty_proto_t *alert;
+        while (rv == 0 && (alert = reader->next ())) {
+            if (compactor.keep (alert)) {
+                rv = writer->add (&alert);
+                if (rv == 0)
+                    converted++;
+            }
+            fty_proto_destroy (&alert);
+        }
+        if (rv == 0)
+            rv = writer->close ();
+        if (rv == 0) {
+            printf ("%s: %zu alerts converted, %zu records skipped%s\n", state_file,
+                converted, reader->skipped (), reader->damaged () ? ", file damaged" : "");
+            if (compactor.duplicates () || compactor.expired () || compactor.capped ())
+                printf ("%s: %zu duplicates, %zu expired and %zu RESOLVED alerts over the limit dropped\n",
+                    state_file, compactor.duplicates (), compactor.expired (), compactor.capped ());
+            if (reader->skipped ())
+                log_warning ("%zu records of %s skipped", reader->skipped (), state_file);
+        }
+    }
 
-    return 0;
+    delete writer;
+    delete reader;
+    if (data)
+        munmap (data, size);
+    zstr_free (&state_file);
+    return rv;
 }
 
 
+// parse positive decimal 'string' up to 'max' into 'number'
+// 0 - success, -1 - not a number, trailing characters included
+static int
+s_parse_count (const char *string, uint64_t max, uint64_t *number)
+{
+    if (!isdigit ((unsigned char) string [0]))
+        return -1;
+    char *end = NULL;
+    errno = 0;
+    unsigned long long value = strtoull (string, &end, 10);
+    if (*end != '\0' || errno == ERANGE || value == 0 || value > max)
+        return -1;
+    *number = (uint64_t) value;
+    return 0;
+}
+
 int main (int argc, char *argv [])
 {
+    format_t from = FORMAT_AUTO;
+    format_t to = FORMAT_LEGACY;
+    compact_t compact = { false, 0, 0 };
+    const char *args [3];
+    int count = 0;
+
     int argn;
     for (argn = 1; argn < argc; argn++) {
         if (streq (argv [argn], "--help")
         ||  streq (argv [argn], "-h")) {
-            puts ("fty-alert-list-convert [file_name] [old_path] [new_path]");
-            puts ("Converts bios_proto state file to fty_proto state file.");
+            puts ("fty-alert-list-convert [options] file_name old_path new_path");
+            puts ("Converts state file old_path/file_name to new_path/file_name.");
+            puts ("  --from / -f FORMAT     format of the state file: auto (default), bios, legacy, zpl, image");
+            puts ("  --to / -t FORMAT       format to convert to: legacy (default), zpl, image");
+            puts ("  --dedupe               drop later records of an alert, like the agent does when loading");
+            puts ("  --max-age D            drop RESOLVED alerts older than D days");
+            puts ("  --max-resolved N       drop RESOLVED alerts but the N newest (implies --dedupe)");
+            puts ("  --verbose / -v         verbose output");
             puts ("  --help / -h            this information");
             return 0;
         }
+        else
+        if ((streq (argv [argn], "--from") || streq (argv [argn], "-f")) && argn + 1 < argc) {
+            from = s_format_from_string (argv [++argn]);
+            if (from == FORMAT_UNKNOWN) {
+                printf ("Unknown format: %s\n", argv [argn]);
+                return 1;
+            }
+        }
+        else
+        if ((streq (argv [argn], "--to") || streq (argv [argn], "-t")) && argn + 1 < argc) {
+            to = s_format_from_string (argv [++argn]);
+            if (to == FORMAT_UNKNOWN || to == FORMAT_AUTO || to == FORMAT_BIOS) {
+                printf ("Unsupported output format: %s\n", argv [argn]);
+                return 1;
+            }
+        }
+        else
+        if (streq (argv [argn], "--dedupe"))
+            compact.dedupe = true;
+        else
+        if (streq (argv [argn], "--max-age") && argn + 1 < argc) {
+            uint64_t days;
+            if (s_parse_count (argv [++argn], UINT64_MAX / (24 * 3600), &days) != 0) {
+                printf ("Invalid number of days: %s\n", argv [argn]);
+                return 1;
+            }
+            compact.max_age = days * 24 * 3600;
+        }
+        else
+        if (streq (argv [argn], "--max-resolved") && argn + 1 < argc) {
+            uint64_t alerts;
+            if (s_parse_count (argv [++argn], SIZE_MAX, &alerts) != 0) {
+                printf ("Invalid number of alerts: %s\n", argv [argn]);
+                return 1;
+            }
+            compact.max_resolved = (size_t) alerts;
+        }
+        else
+        if (streq (argv [argn], "--verbose")
+        ||  streq (argv [argn], "-v"))
+            ManageFtyLog::getInstanceFtylog ()->setVerboseMode ();
+        else
+        if (argv [argn][0] != '-' && count < 3)
+            args [count++] = argv [argn];
+        else {
+            printf ("Unknown option: %s\n", argv [argn]);
+            return 1;
+        }
+    }
+    if (count != 3) {
+        puts ("fty-alert-list-convert [options] file_name old_path new_path");
+        return 1;
     }
 
-    int rv = convert_file  (argv [1], argv [2], argv [3]);
-    assert (rv == 0);
-
-    return 0;
+    return convert_file (args [0], args [1], args [2], from, to, compact) == 0 ? 0 : 1;
 }
@@ -0,0 +1,393 @@
+/*  =========================================================================
+    fty_alert_list_inspect - Inspects state files without running the agent.
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/*
+@header
+    fty_alert_list_inspect - Inspects state files without running the agent.
+@discuss
+    Loads a state file the way the agent does at startup and prints the
+    number of alerts by state, severity and rule, the alerts as JSON, or
+    the differences from another state file.
+
+    A state image without a journal is queried in place: the records are
+    read from the mapped file and only alerts printed as JSON are decoded.
+    Other state files are loaded with alert_load_state (), journal applied.
+@end
+*/
+
+#include <libgen.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <fty_common_utf8.h>
+#include "fty_alert_list_classes.h"
+
+// alert of a state file, strings are owned by the state
+typedef struct {
+    const char *rule;
+    const char *name;
+    const char *state;
+    const char *severity;
+    const char *description;
+    uint64_t time;
+    uint32_t ttl;
+    fty_proto_t *alert;         // loaded alert, NULL for a record of an image
+    size_t index;               // record of the image
+} entry_t;
+
+// filters of alerts, NULL - any
+typedef struct {
+    const char *element;
+    const char *rule;
+    const char *state;
+} filter_t;
+
+static const char *
+s_str (const char *string)
+{
+    return string ? string : "";
+}
+
+// alerts of one state file
+class s_state {
+    public:
+        ~s_state ()
+        {
+            alert_image_destroy (&m_image);
+            zlistx_destroy (&m_alerts);
+        }
+
+        // load state file 'file' (path and file name), alerts matching 'filter'
+        // 0 - success, -1 - error
+        int load (const char *file, const filter_t &filter)
+        {
+            char *dir = strdup (file);
+            char *base = strdup (file);
+            std::string path = dirname (dir);
+            std::string filename = basename (base);
+            free (dir);
+            free (base);
+
+            // an image failing verification is loaded by alert_load_state (),
+            // which falls back to the previous generation as the agent does
+            if (!s_journal_exists (path, filename))
+                m_image = alert_image_open (path.c_str (), filename.c_str ());
+            if (m_image) {
+                m_entries.reserve (alert_image_count (m_image));
+                std::unordered_set<const char *> identities;
+                identities.reserve (alert_image_count (m_image));
+                for (size_t index = 0; index < alert_image_count (m_image); index++) {
+                    const alert_image_record_t *record = alert_image_record (m_image, index);
+                    const char *identity = alert_intern_identity (
+                        alert_image_str (m_image, record->rule), alert_image_str (m_image, record->name));
+                    // first record of an alert wins, as with alert_load_state ()
+                    if (identity && !identities.insert (identity).second)
+                        continue;
+                    entry_t entry = {
+                        alert_image_str (m_image, record->rule),
+                        alert_image_str (m_image, record->name),
+                        alert_image_str (m_image, record->state_name),
+                        alert_image_str (m_image, record->severity),
+                        alert_image_str (m_image, record->description),
+                        record->time,
+                        record->ttl,
+                        NULL,
+                        index
+                    };
+                    if (s_matches (entry, filter))
+                        m_entries.push_back (entry);
+                }
+                return 0;
+            }
+
+            m_alerts = zlistx_new ();
+            if (!m_alerts)
+                return -1;
+            zlistx_set_destructor (m_alerts, (czmq_destructor *) fty_proto_destroy);
+            if (alert_load_state (m_alerts, path.c_str (), filename.c_str ()) != 0)
+                return -1;
+            m_entries.reserve (zlistx_size (m_alerts));
+            for (fty_proto_t *alert = (fty_proto_t *) zlistx_first (m_alerts); alert;
+                    alert = (fty_proto_t *) zlistx_next (m_alerts)) {
+                entry_t entry = {
+                    s_str (fty_proto_rule (alert)),
+                    s_str (fty_proto_name (alert)),
+                    s_str (fty_proto_state (alert)),
+                    s_str (fty_proto_severity (alert)),
+                    s_str (fty_proto_description (alert)),
+                    fty_proto_time (alert),
+                    fty_proto_ttl (alert),
+                    alert,
+                    0
+                };
+                if (s_matches (entry, filter))
+                    m_entries.push_back (entry);
+            }
+            return 0;
+        }
+
+        const std::vector<entry_t> &entries () const { return m_entries; }
+
+        // alert of 'entry' decoded, destroy it
+        fty_proto_t *decode (const entry_t &entry)
+        {
+            if (entry.alert)
+                return fty_proto_dup (entry.alert);
+            return alert_image_decode (m_image, entry.index);
+        }
+
+    private:
+        static bool s_journal_exists (const std::string &path, const std::string &filename)
+        {
+            const char *suffixes [] = { JOURNAL_SUFFIX, JOURNAL_ROTATED_SUFFIX };
+            for (const char *suffix : suffixes) {
+                std::string journal = path + "/" + filename + suffix;
+                if (zsys_file_exists (journal.c_str ()))
+                    return true;
+            }
+            return false;
+        }
+
+        static bool s_matches (const entry_t &entry, const filter_t &filter)
+        {
+            return (!filter.element || UTF8::utf8eq (entry.name, filter.element) == 1)
+                && (!filter.rule || UTF8::utf8eq (entry.rule, filter.rule) == 1)
+                && (!filter.state || streq (entry.state, filter.state));
+        }
+
+        alert_image_t *m_image = NULL;
+        zlistx_t *m_alerts = NULL;
+        std::vector<entry_t> m_entries;
+};
+
+// print counts of 'counts', the largest first
+static void
+s_print_counts (const char *title, const std::map<std::string, size_t> &counts)
+{
+    std::vector<std::pair<std::string, size_t>> sorted (counts.begin (), counts.end ());
+    std::stable_sort (sorted.begin (), sorted.end (),
+        [] (const std::pair<std::string, size_t> &a, const std::pair<std::string, size_t> &b) {
+            return a.second > b.second;
+        });
+    printf ("%s:\n", title);
+    for (const auto &count : sorted)
+        printf ("    %-40s %zu\n", count.first.empty () ? "(none)" : count.first.c_str (), count.second);
+}
+
+static void
+s_summary (const char *file, s_state &state)
+{
+    std::map<std::string, size_t> states, severities, rules;
+    for (const entry_t &entry : state.entries ()) {
+        states [entry.state]++;
+        severities [entry.severity]++;
+        rules [entry.rule]++;
+    }
+    printf ("%s: %zu alerts\n", file, state.entries ().size ());
+    s_print_counts ("state", states);
+    s_print_counts ("severity", severities);
+    s_print_counts ("rule", rules);
+}
+
+// print 'string' as JSON string
+static void
+s_json_string (const char *string)
+{
+    putchar ('"');
+    for (const unsigned char *c = (const unsigned char *) s_str (string); *c; c++) {
+        switch (*c) {
+            case '"':  fputs ("\\\"", stdout); break;
+            case '\\': fputs ("\\\\", stdout); break;
+            case '\n': fputs ("\\n", stdout); break;
+            case '\r': fputs ("\\r", stdout); break;
+            case '\t': fputs ("\\t", stdout); break;
+            default:
+                if (*c < 0x20)
+                    printf ("\\u%04x", *c);
+                else
+                    putchar (*c);
+        }
+    }
+    putchar ('"');
+}
+
+static void
+s_json (s_state &state)
+{
+    printf ("[");
+    bool first = true;
+    for (const entry_t &entry : state.entries ()) {
+        fty_proto_t *alert = state.decode (entry);
+        if (!alert)
+            continue;
+        printf ("%s\n  {\"rule\": ", first ? "" : ",");
+        first = false;
+        s_json_string (fty_proto_rule (alert));
+        printf (", \"element\": ");
+        s_json_string (fty_proto_name (alert));
+        printf (", \"state\": ");
+        s_json_string (fty_proto_state (alert));
+        printf (", \"severity\": ");
+        s_json_string (fty_proto_severity (alert));
+        printf (", \"time\": %" PRIu64 ", \"ttl\": %" PRIu32 ", \"description\": ",
+            fty_proto_time (alert), fty_proto_ttl (alert));
+        s_json_string (fty_proto_description (alert));
+        printf (", \"metadata\": ");
+        s_json_string (fty_proto_metadata (alert));
+        printf (", \"actions\": [");
+        zlist_t *actions = fty_proto_action (alert);
+        for (const char *action = actions ? (const char *) zlist_first (actions) : NULL;
+                action; action = (const char *) zlist_next (actions)) {
+            if (action != zlist_first (actions))
+                printf (", ");
+            s_json_string (action);
+        }
+        printf ("]}");
+        fty_proto_destroy (&alert);
+    }
+    printf ("%s]\n", first ? "" : "\n");
+}
+
+static void
+s_print_entry (char mark, const entry_t &entry)
+{
+    printf ("%c %s@%s %s %s %" PRIu64 "\n", mark, entry.rule, entry.name, entry.state, entry.severity, entry.time);
+}
+
+// print differences of 'second' from 'first'
+// returns number of differences
+static size_t
+s_diff (s_state &first, s_state &second)
+{
+    std::unordered_map<const char *, const entry_t *> identities;
+    identities.reserve (first.entries ().size ());
+    for (const entry_t &entry : first.entries ())
+        identities.emplace (alert_intern_identity (entry.rule, entry.name), &entry);
+
+    size_t added = 0, removed = 0, changed = 0;
+    for (const entry_t &entry : second.entries ()) {
+        auto it = identities.find (alert_intern_identity (entry.rule, entry.name));
+        if (it == identities.end ()) {
+            s_print_entry ('+', entry);
+            added++;
+            continue;
+        }
+        const entry_t *old = it->second;
+        identities.erase (it);
+        if (!streq (old->state, entry.state) || !streq (old->severity, entry.severity)
+        ||  !streq (old->description, entry.description) || old->time != entry.time
+        ||  old->ttl != entry.ttl) {
+            s_print_entry ('<', *old);
+            s_print_entry ('>', entry);
+            changed++;
+        }
+    }
+    // in order of the first file
+    for (const entry_t &entry : first.entries ()) {
+        if (identities.count (alert_intern_identity (entry.rule, entry.name))) {
+            s_print_entry ('-', entry);
+            removed++;
+        }
+    }
+    printf ("%zu added, %zu removed, %zu changed\n", added, removed, changed);
+    return added + removed + changed;
+}
+
+int main (int argc, char *argv [])
+{
+    filter_t filter = { NULL, NULL, NULL };
+    bool json = false;
+    bool diff = false;
+    const char *files [2];
+    int count = 0;
+
+    int argn;
+    for (argn = 1; argn < argc; argn++) {
+        if (streq (argv [argn], "--help")
+        ||  streq (argv [argn], "-h")) {
+            puts ("fty-alert-list-inspect [options] state_file [other_state_file]");
+            puts ("Prints number of alerts of state_file by state, severity and rule.");
+            puts ("  --element / -e NAME    only alerts of element NAME");
+            puts ("  --rule / -r RULE       only alerts of rule RULE");
+            puts ("  --state / -s STATE     only alerts in state STATE");
+            puts ("  --json / -j            print the alerts as JSON");
+            puts ("  --diff / -d            print differences of other_state_file from state_file");
+            puts ("  --verbose / -v         verbose output");
+            puts ("  --help / -h            this information");
+            return 0;
+        }
+        else
+        if ((streq (argv [argn], "--element") || streq (argv [argn], "-e")) && argn + 1 < argc)
+            filter.element = argv [++argn];
+        else
+        if ((streq (argv [argn], "--rule") || streq (argv [argn], "-r")) && argn + 1 < argc)
+            filter.rule = argv [++argn];
+        else
+        if ((streq (argv [argn], "--state") || streq (argv [argn], "-s")) && argn + 1 < argc)
+            filter.state = argv [++argn];
+        else
+        if (streq (argv [argn], "--json")
+        ||  streq (argv [argn], "-j"))
+            json = true;
+        else
+        if (streq (argv [argn], "--diff")
+        ||  streq (argv [argn], "-d"))
+            diff = true;
+        else
+        if (streq (argv [argn], "--verbose")
+        ||  streq (argv [argn], "-v"))
+            ManageFtyLog::getInstanceFtylog ()->setVerboseMode ();
+        else
+        if (argv [argn][0] != '-' && count < 2)
+            files [count++] = argv [argn];
+        else {
+            printf ("Unknown option: %s\n", argv [argn]);
+            return 2;
+        }
+    }
+    if (count != (diff ? 2 : 1)) {
+        puts ("fty-alert-list-inspect [options] state_file [other_state_file]");
+        return 2;
+    }
+
+    s_state first;
+    if (first.load (files [0], filter) != 0) {
+        printf ("Cannot load %s\n", files [0]);
+        return 2;
+    }
+    if (diff) {
+        s_state second;
+        if (second.load (files [1], filter) != 0) {
+            printf ("Cannot load %s\n", files [1]);
+            return 2;
+        }
+        // like diff (1): 0 - same, 1 - different
+        return s_diff (first, second) ? 1 : 0;
+    }
+    if (json)
+        s_json (first);
+    else
+        s_summary (files [0], first);
+    return 0;
+}
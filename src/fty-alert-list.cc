@@ -26,68 +26,328 @@
 @end
  */
 
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <sys/signalfd.h>
+#include <unistd.h>
+#include <string>
 #include "fty_alert_list_classes.h"
 
+#define DEFAULT_CONFIG "/etc/fty-alert-list/fty-alert-list.cfg"
+
+// settings taking effect at startup only
+static const char *STARTUP_SETTINGS [] = {
+    "malamute/endpoint", "server/state_path", "server/state_file", "server/verbose",
+    "server/load_threads", "server/announce", NULL
+};
+
+typedef struct {
+    const char *path;           // configuration file
+    zconfig_t *config;          // configuration file as loaded, NULL - defaults
+    zconfig_t *overrides;       // command line options, they win over the file
+    zconfig_t *startup;         // STARTUP_SETTINGS as used at startup
+    zactor_t *stream;
+    zloop_t *timers;
+    int64_t ttlInterval;
+    int64_t statsInterval;
+    int ttlTimer;
+    int statsTimer;
+    // settings of the stream actor as last sent, kept when mistyped
+    int64_t flapWindow;
+    int64_t flapTransitions;
+    int64_t flapHoldDown;
+    int64_t keepaliveRate;
+    int64_t checkpointInterval;
+    int64_t checkpointDirty;
+    int64_t journalLimit;
+    int64_t checkpointChunk;
+    std::string stateFormat;
+} agent_t;
+
+// value of setting 'path': command line, configuration file or 'value'
+static const char *
+s_setting (agent_t *agent, const char *path, const char *value) {
+    if (zconfig_locate (agent->overrides, path))
+        return zconfig_get (agent->overrides, path, value);
+    if (agent->config)
+        return zconfig_get (agent->config, path, value);
+    return value;
+}
+
+// integer setting 'path' (default 'value') within 'min' .. 'max'; a
+// mistyped value is logged and 'previous' is returned, so that a reload
+// doesn't stop timers or change units
+static int64_t
+s_setting_number (agent_t *agent, const char *path, const char *value, int64_t previous,
+        int64_t min = 0, int64_t max = INT_MAX) {
+    value = s_setting (agent, path, value);
+    char *end = NULL;
+    errno = 0;
+    long long number = strtoll (value, &end, 10);
+    if (end == value || *end != '\0' || errno == ERANGE || number < min || number > max) {
+        log_error ("%s = '%s' is not a valid number, %" PRIi64 " is kept", path, value, previous);
+        return previous;
+    }
+    return (int64_t) number;
+}
+
 static int
 s_ttl_cleanup_timer(zloop_t *loop, int timer_id, void *output) {
     zstr_send(output, "TTLCLEANUP");
     return 0;
 }
 
+static int
+s_stats_timer(zloop_t *loop, int timer_id, void *output) {
+    zstr_send(output, "STATS");
+    return 0;
+}
+
+// (re)start timer 'timer_p' when its interval changed, 0 - stopped
+static void
+s_timer_set (agent_t *agent, int *timer_p, int64_t *interval_p, int64_t interval, zloop_timer_fn handler) {
+    if (*timer_p != -1 && interval == *interval_p)
+        return;
+    if (*timer_p != -1)
+        zloop_timer_end (agent->timers, *timer_p);
+    *timer_p = -1;
+    *interval_p = interval;
+    if (interval > 0)
+        *timer_p = zloop_timer (agent->timers, (size_t) interval * 1000, 0, handler, agent->stream);
+}
+
+// pass settings which may change at run time to the stream actor and timers
+static void
+s_configure (agent_t *agent) {
+    agent->flapWindow = s_setting_number (agent, "flapping/window", "300", agent->flapWindow, 1);
+    agent->flapTransitions = s_setting_number (agent, "flapping/transitions", "0", agent->flapTransitions, 0, UINT32_MAX);
+    agent->flapHoldDown = s_setting_number (agent, "flapping/hold_down", "120", agent->flapHoldDown);
+    agent->keepaliveRate = s_setting_number (agent, "keepalive/rate", "50", agent->keepaliveRate, 1);
+    agent->checkpointInterval = s_setting_number (agent, "checkpoint/interval", "300", agent->checkpointInterval);
+    agent->checkpointDirty = s_setting_number (agent, "checkpoint/dirty", "1000", agent->checkpointDirty, 0, INT64_MAX);
+    agent->journalLimit = s_setting_number (agent, "checkpoint/journal_limit", "4194304", agent->journalLimit, 0, INT64_MAX);
+    agent->checkpointChunk = s_setting_number (agent, "checkpoint/chunk", "128", agent->checkpointChunk, 1);
+
+    zstr_sendx (agent->stream, "FLAPPING",
+        std::to_string (agent->flapWindow).c_str (),
+        std::to_string (agent->flapTransitions).c_str (),
+        std::to_string (agent->flapHoldDown).c_str (), NULL);
+    zstr_sendx (agent->stream, "KEEPALIVE",
+        std::to_string (agent->keepaliveRate).c_str (), NULL);
+    zstr_sendx (agent->stream, "CHECKPOINT",
+        std::to_string (agent->checkpointInterval).c_str (),
+        std::to_string (agent->checkpointDirty).c_str (),
+        std::to_string (agent->journalLimit).c_str (),
+        std::to_string (agent->checkpointChunk).c_str (), NULL);
+
+    const char *format = s_setting (agent, "server/state_format", "zpl");
+    if (streq (format, "zpl") || streq (format, "image"))
+        agent->stateFormat = format;
+    else
+        log_error ("server/state_format = '%s' is not zpl or image, %s is kept", format, agent->stateFormat.c_str ());
+    zstr_sendx (agent->stream, "STATEFORMAT", agent->stateFormat.c_str (), NULL);
+    s_timer_set (agent, &agent->ttlTimer, &agent->ttlInterval,
+        s_setting_number (agent, "server/ttl_interval", "60", agent->ttlInterval), s_ttl_cleanup_timer);
+    s_timer_set (agent, &agent->statsTimer, &agent->statsInterval,
+        s_setting_number (agent, "server/stats_interval", "3600", agent->statsInterval), s_stats_timer);
+}
+
+// load configuration file; a missing file means defaults
+// 0 - success, -1 - the file can't be parsed
+static int
+s_config_load (agent_t *agent) {
+    zconfig_t *config = NULL;
+    if (zsys_file_exists (agent->path)) {
+        config = zconfig_load (agent->path);
+        if (!config) {
+            log_error ("can't parse configuration file %s", agent->path);
+            return -1;
+        }
+        log_info ("configuration loaded from %s", agent->path);
+    }
+    else
+        log_info ("configuration file %s not found, using defaults", agent->path);
+    zconfig_destroy (&agent->config);
+    agent->config = config;
+    return 0;
+}
+
+// reread the configuration file and apply it, the cache is kept
+static void
+s_reload (agent_t *agent, const char *reason) {
+    log_info ("reloading configuration (%s)", reason);
+    if (s_config_load (agent) != 0) {
+        log_error ("configuration not changed");
+        return;
+    }
+    for (const char **path = STARTUP_SETTINGS; *path; path++) {
+        if (!streq (s_setting (agent, *path, ""), zconfig_get (agent->startup, *path, "")))
+            log_warning ("%s changed, restart fty-alert-list to apply it", *path);
+    }
+    s_configure (agent);
+}
+
+static int
+s_signal_reader (zloop_t *loop, zmq_pollitem_t *item, void *arg) {
+    struct signalfd_siginfo info;
+    if (read (item->fd, &info, sizeof (info)) == (ssize_t) sizeof (info) && info.ssi_signo == SIGHUP)
+        s_reload ((agent_t *) arg, "SIGHUP");
+    return 0;
+}
+
+static int
+s_mailbox_reader (zloop_t *loop, zsock_t *reader, void *arg) {
+    char *command = zstr_recv (reader);
+    if (command && streq (command, "RELOAD"))
+        s_reload ((agent_t *) arg, "mailbox request");
+    zstr_free (&command);
+    return 0;
+}
+
 int main(int argc, char *argv []) {
-    bool verbose = false;
+    agent_t agent = { DEFAULT_CONFIG, NULL, zconfig_new ("root", NULL), zconfig_new ("root", NULL),
+        NULL, NULL, 60, 3600, -1, -1, 300, 0, 120, 50, 300, 1000, 4194304, 128, "zpl" };
 
     int argn;
     for (argn = 1; argn < argc; argn++) {
         if (streq(argv [argn], "--help") ||
                 streq(argv [argn], "-h")) {
             puts("fty-alert-list [options] ...");
+            puts("  --config / -c FILE     configuration file (default " DEFAULT_CONFIG ")");
             puts("  --verbose / -v         verbose test output");
+            puts("  --flap-transitions N   damp alerts changing state N times within flap window (default 0 - never)");
+            puts("  --flap-window S        flap window in seconds (default 300)");
+            puts("  --flap-hold-down S     publish damped alert after S seconds without a state change (default 120)");
+            puts("  --keepalive-rate N     republish at most N ACTIVE alerts per second to keep them alive (default 50)");
+            puts("  --announce N           republish loaded alerts not RESOLVED at startup, N per second");
+            puts("  --checkpoint S         save alerts state every S seconds when changed (default 300, 0 - never)");
+            puts("  --checkpoint-dirty N   save alerts state after N changes (default 1000, 0 - never)");
+            puts("  --journal-limit B      save alerts state when its journal reaches B bytes (default 4 MiB, 0 - never)");
+            puts("  --ttl-interval S       resolve alerts whose TTL expired every S seconds (default 60)");
+            puts("  --stats-interval S     log counters every S seconds (default 3600, 0 - never)");
             puts("  --help / -h            this information");
+            puts("Options override the configuration file, which is reread on SIGHUP.");
+            zconfig_destroy (&agent.overrides);
+            zconfig_destroy (&agent.startup);
             return EXIT_SUCCESS;
         }
+        else if ((streq(argv [argn], "--config") ||
+                streq(argv [argn], "-c")) && argn + 1 < argc) {
+            agent.path = argv [++argn];
+        }
         else if (streq(argv [argn], "--verbose") ||
                 streq(argv [argn], "-v")) {
-            verbose = true;
+            zconfig_put (agent.overrides, "server/verbose", "1");
+        }
+        else if (streq(argv [argn], "--flap-transitions") && argn + 1 < argc) {
+            zconfig_put (agent.overrides, "flapping/transitions", argv [++argn]);
+        }
+        else if (streq(argv [argn], "--flap-window") && argn + 1 < argc) {
+            zconfig_put (agent.overrides, "flapping/window", argv [++argn]);
+        }
+        else if (streq(argv [argn], "--flap-hold-down") && argn + 1 < argc) {
+            zconfig_put (agent.overrides, "flapping/hold_down", argv [++argn]);
+        }
+        else if (streq(argv [argn], "--keepalive-rate") && argn + 1 < argc) {
+            zconfig_put (agent.overrides, "keepalive/rate", argv [++argn]);
+        }
+        else if (streq(argv [argn], "--announce") && argn + 1 < argc) {
+            zconfig_put (agent.overrides, "server/announce", argv [++argn]);
+        }
+        else if (streq(argv [argn], "--checkpoint") && argn + 1 < argc) {
+            zconfig_put (agent.overrides, "checkpoint/interval", argv [++argn]);
+        }
+        else if (streq(argv [argn], "--checkpoint-dirty") && argn + 1 < argc) {
+            zconfig_put (agent.overrides, "checkpoint/dirty", argv [++argn]);
+        }
+        else if (streq(argv [argn], "--journal-limit") && argn + 1 < argc) {
+            zconfig_put (agent.overrides, "checkpoint/journal_limit", argv [++argn]);
+        }
+        else if (streq(argv [argn], "--ttl-interval") && argn + 1 < argc) {
+            zconfig_put (agent.overrides, "server/ttl_interval", argv [++argn]);
+        }
+        else if (streq(argv [argn], "--stats-interval") && argn + 1 < argc) {
+            zconfig_put (agent.overrides, "server/stats_interval", argv [++argn]);
         }
         else {
             printf("Unknown option: %s\n", argv [argn]);
+            zconfig_destroy (&agent.overrides);
+            zconfig_destroy (&agent.startup);
             return EXIT_FAILURE;
         }
     }
 
+    // SIGHUP is read from a descriptor by the timers loop; it's blocked
+    // before any thread starts, so that no other thread takes it
+    sigset_t hangup;
+    sigemptyset (&hangup);
+    sigaddset (&hangup, SIGHUP);
+    pthread_sigmask (SIG_BLOCK, &hangup, NULL);
+    int signals = signalfd (-1, &hangup, SFD_CLOEXEC | SFD_NONBLOCK);
+
     ManageFtyLog::setInstanceFtylog ("fty-alert-list", FTY_COMMON_LOGGING_DEFAULT_CFG);
+    if (s_config_load (&agent) != 0) {
+        zconfig_destroy (&agent.overrides);
+        zconfig_destroy (&agent.startup);
+        return EXIT_FAILURE;
+    }
+    for (const char **path = STARTUP_SETTINGS; *path; path++)
+        zconfig_put (agent.startup, *path, s_setting (&agent, *path, ""));
+
+    bool verbose = atoi (s_setting (&agent, "server/verbose", "0")) != 0;
     if (verbose) ManageFtyLog::getInstanceFtylog()->setVerboseMode();
 
     //  Insert main code here
     log_debug("fty-alert-list - Agent providing information about active alerts"); // TODO: rewrite alerts_list_server to accept VERBOSE
     log_info("fty-alert-list starting");
 
-    const char *endpoint = "ipc://@/malamute";
+    std::string endpoint = s_setting (&agent, "malamute/endpoint", "ipc://@/malamute");
 
     //init the alert list (common with stream and mailbox treatment)
 
+    set_state_file (s_setting (&agent, "server/state_path", "/var/lib/fty/fty-alert-list"),
+        s_setting (&agent, "server/state_file", "state_file"));
+    alert_load_set_threads ((size_t) s_setting_number (&agent, "server/load_threads", "0", 0));
     init_alert(verbose); // read alerts state_file
 
     //initialize actors and timer for stream
 
-    zactor_t *alert_list_server_mailbox = zactor_new(fty_alert_list_server_mailbox, (void *) endpoint);
+    zactor_t *alert_list_server_mailbox = zactor_new(fty_alert_list_server_mailbox, (void *) endpoint.c_str ());
 
-    zactor_t *alert_list_server_stream = zactor_new(fty_alert_list_server_stream, (void *) endpoint);
+    zactor_t *alert_list_server_stream = zactor_new(fty_alert_list_server_stream, (void *) endpoint.c_str ());
 
-    zloop_t *ttlcleanup_stream = zloop_new();
-    zloop_timer(ttlcleanup_stream, 60 * 1000, 0, s_ttl_cleanup_timer, alert_list_server_stream);
-    zloop_start(ttlcleanup_stream);
+    // timers of the agent; the loop sleeps until the next one is due or the
+    // configuration is to be reloaded, and returns when the agent is
+    // interrupted (SIGINT, SIGTERM)
+    agent.stream = alert_list_server_stream;
+    agent.timers = zloop_new();
+    s_configure (&agent);
+    int64_t announceRate = s_setting_number (&agent, "server/announce", "0", 0);
+    if (announceRate > 0)
+        zstr_sendx(alert_list_server_stream, "ANNOUNCE", std::to_string (announceRate).c_str (), NULL);
 
-    while (!zsys_interrupted) {
-        sleep(1000);
-    }
+    zmq_pollitem_t hangupItem = { NULL, signals, ZMQ_POLLIN, 0 };
+    if (signals != -1)
+        zloop_poller (agent.timers, &hangupItem, s_signal_reader, &agent);
+    else
+        log_warning ("SIGHUP is ignored, signalfd () failed: %s", strerror (errno));
+    zloop_reader (agent.timers, zactor_sock (alert_list_server_mailbox), s_mailbox_reader, &agent);
+    zloop_start(agent.timers);
+    zloop_destroy(&agent.timers);
 
-    save_alerts();
-    zloop_destroy(&ttlcleanup_stream);
+    // ordered shutdown: alerts and requests already received are handled,
+    // then the cache is saved
+    log_info("fty-alert-list stopping");
     zactor_destroy(&alert_list_server_stream);
     zactor_destroy(&alert_list_server_mailbox);
+    save_alerts();
     destroy_alert();
 
+    if (signals != -1)
+        close (signals);
+    zconfig_destroy (&agent.config);
+    zconfig_destroy (&agent.overrides);
+    zconfig_destroy (&agent.startup);
     return EXIT_SUCCESS;
 }
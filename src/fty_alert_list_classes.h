@@ -41,6 +41,38 @@ typedef struct _alerts_utils_t alerts_utils_t;
 typedef struct _bios_proto_t bios_proto_t;
 #define BIOS_PROTO_T_DEFINED
 #endif
+#ifndef ALERT_INTERN_T_DEFINED
+typedef struct _alert_intern_t alert_intern_t;
+#define ALERT_INTERN_T_DEFINED
+#endif
+#ifndef ALERT_STATS_T_DEFINED
+typedef struct _alert_stats_t alert_stats_t;
+#define ALERT_STATS_T_DEFINED
+#endif
+#ifndef ALERT_POOL_T_DEFINED
+typedef struct _alert_pool_t alert_pool_t;
+#define ALERT_POOL_T_DEFINED
+#endif
+#ifndef ALERT_FRAME_T_DEFINED
+typedef struct _alert_frame_t alert_frame_t;
+#define ALERT_FRAME_T_DEFINED
+#endif
+#ifndef ALERT_JOURNAL_T_DEFINED
+typedef struct _alert_journal_t alert_journal_t;
+#define ALERT_JOURNAL_T_DEFINED
+#endif
+#ifndef ALERT_IMAGE_T_DEFINED
+typedef struct _alert_image_t alert_image_t;
+#define ALERT_IMAGE_T_DEFINED
+#endif
+#ifndef ALERT_IMAGE_WRITER_T_DEFINED
+typedef struct _alert_image_writer_t alert_image_writer_t;
+#define ALERT_IMAGE_WRITER_T_DEFINED
+#endif
+#ifndef ALERT_ZPL_READER_T_DEFINED
+typedef struct _alert_zpl_reader_t alert_zpl_reader_t;
+#define ALERT_ZPL_READER_T_DEFINED
+#endif
 
 //  Extra headers
 
@@ -48,6 +80,13 @@ typedef struct _bios_proto_t bios_proto_t;
 
 #include "alerts_utils.h"
 #include "bios_proto.h"
+#include "alert_intern.h"
+#include "alert_stats.h"
+#include "alert_pool.h"
+#include "alert_frame.h"
+#include "alert_journal.h"
+#include "alert_image.h"
+#include "alert_zpl_reader.h"
 
 //  *** To avoid double-definitions, only define if building without draft ***
 #ifndef FTY_ALERT_LIST_BUILD_DRAFT_API
@@ -62,6 +101,41 @@ FTY_ALERT_LIST_PRIVATE void
 FTY_ALERT_LIST_PRIVATE void
     bios_proto_test (bool verbose);
 
+//  *** Draft method, defined for internal use only ***
+//  Self test of this class.
+FTY_ALERT_LIST_PRIVATE void
+    alert_intern_test (bool verbose);
+
+//  *** Draft method, defined for internal use only ***
+//  Self test of this class.
+FTY_ALERT_LIST_PRIVATE void
+    alert_stats_test (bool verbose);
+
+//  *** Draft method, defined for internal use only ***
+//  Self test of this class.
+FTY_ALERT_LIST_PRIVATE void
+    alert_pool_test (bool verbose);
+
+//  *** Draft method, defined for internal use only ***
+//  Self test of this class.
+FTY_ALERT_LIST_PRIVATE void
+    alert_frame_test (bool verbose);
+
+//  *** Draft method, defined for internal use only ***
+//  Self test of this class.
+FTY_ALERT_LIST_PRIVATE void
+    alert_journal_test (bool verbose);
+
+//  *** Draft method, defined for internal use only ***
+//  Self test of this class.
+FTY_ALERT_LIST_PRIVATE void
+    alert_image_test (bool verbose);
+
+//  *** Draft method, defined for internal use only ***
+//  Self test of this class.
+FTY_ALERT_LIST_PRIVATE void
+    alert_zpl_reader_test (bool verbose);
+
 //  Self test for private classes
 FTY_ALERT_LIST_PRIVATE void
     fty_alert_list_private_selftest (bool verbose, const char *subtest);
@@ -42,6 +42,20 @@ fty_alert_list_private_selftest (bool verbose, const char *subtest)
         alerts_utils_test (verbose);
     if (streq (subtest, "$ALL") || streq (subtest, "bios_proto_test"))
         bios_proto_test (verbose);
+    if (streq (subtest, "$ALL") || streq (subtest, "alert_intern_test"))
+        alert_intern_test (verbose);
+    if (streq (subtest, "$ALL") || streq (subtest, "alert_stats_test"))
+        alert_stats_test (verbose);
+    if (streq (subtest, "$ALL") || streq (subtest, "alert_pool_test"))
+        alert_pool_test (verbose);
+    if (streq (subtest, "$ALL") || streq (subtest, "alert_frame_test"))
+        alert_frame_test (verbose);
+    if (streq (subtest, "$ALL") || streq (subtest, "alert_journal_test"))
+        alert_journal_test (verbose);
+    if (streq (subtest, "$ALL") || streq (subtest, "alert_image_test"))
+        alert_image_test (verbose);
+    if (streq (subtest, "$ALL") || streq (subtest, "alert_zpl_reader_test"))
+        alert_zpl_reader_test (verbose);
 }
 /*
 ################################################################################
@@ -44,6 +44,13 @@ all_tests [] = {
 // Now built only with --enable-drafts, so even stable builds are hidden behind the flag
     { "alerts_utils", NULL, true, false, "alerts_utils_test" },
     { "bios_proto", NULL, true, false, "bios_proto_test" },
+    { "alert_intern", NULL, true, false, "alert_intern_test" },
+    { "alert_stats", NULL, true, false, "alert_stats_test" },
+    { "alert_pool", NULL, true, false, "alert_pool_test" },
+    { "alert_frame", NULL, true, false, "alert_frame_test" },
+    { "alert_journal", NULL, true, false, "alert_journal_test" },
+    { "alert_image", NULL, true, false, "alert_image_test" },
+    { "alert_zpl_reader", NULL, true, false, "alert_zpl_reader_test" },
     { "private_classes", NULL, false, false, "$ALL" }, // compat option for older projects
 #endif // FTY_ALERT_LIST_BUILD_DRAFT_API
 #ifdef FTY_ALERT_LIST_BUILD_DRAFT_API
@@ -27,81 +27,568 @@
  */
 
 #include <string.h>
-#include <map>
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <deque>
 #include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 #include <fty_common_macros.h>
 #include <fty_common_utf8.h>
 #include "fty_alert_list_classes.h"
 
 #define RFC_ALERTS_LIST_SUBJECT "rfc-alerts-list"
 #define RFC_ALERTS_ACKNOWLEDGE_SUBJECT  "rfc-alerts-acknowledge"
+#define RFC_ALERTS_CONFIG_SUBJECT "rfc-alerts-config"
+
+static std::string statePath = "/var/lib/fty/fty-alert-list";
+static std::string stateFile = "state_file";
+static zsock_t *mailboxPipe = NULL;     // pipe of the mailbox actor, for RELOAD
+
+// bookkeeping kept next to each alert of the cache, values are interned
+typedef struct {
+    const char *identity;   // (rule, element)
+    const char *severity;
+    const char *actions;
+    alert_state_t state;    // parsed fty_proto_state (), kept in sync with it
+    time_t last_sent;       // zclock_mono () / 1000 of last publish on ALERTS
+    int64_t expires;        // zclock_mono () / 1000 when ACTIVE alert times out, 0 - never
+    int64_t keepalive_due;  // zclock_mono () / 1000 when ACTIVE alert is republished, 0 - never
+    bool keepalive_pending; // refreshed since last publish, see s_publish_keepalives ()
+    // flap detection, see s_alert_damp ()
+    int64_t flap_window;    // index of current flapWindow long window
+    uint32_t flap_count;    // state flips in current window
+    uint32_t flap_previous; // state flips in previous window
+    int64_t damped_until;   // zclock_mono () / 1000 when publishing resumes, 0 - not damped
+    alert_state_t damped_state; // state consumers of ALERTS know of damped alert
+} alert_info_t;
+
+// How to publish an alert coming from _ALERTS_SYS
+typedef enum {
+    PUBLISH_NEVER,
+    PUBLISH_ALWAYS,
+    PUBLISH_IF_DUE      // only if we're at risk of timing out (ttl/2 since last publish)
+} publish_t;
+
+// What to do with a cached alert when an ACTIVE or RESOLVED alert comes from _ALERTS_SYS
+typedef struct {
+    publish_t publish;
+    bool take_state;        // take over state and metadata of the incoming alert
+    bool take_time;         // take over time of the incoming alert
+    bool take_description;  // take over description and lifetime of the incoming alert
+    bool reset_ctime;       // time of the incoming alert becomes the creation time
+} transition_t;
+
+#define INCOMING_ACTIVE     0
+#define INCOMING_RESOLVED   1
+
+// Wasn't specified, but common sense applied, it should be:
+// RESOLVED comes from _ALERTS_SYS
+//  * if stored !RESOLVED -> update stored time/state, publish original
+//  * if stored RESOLVED -> don't update stored time, don't publish original
+//
+//  ACTIVE comes form _ALERTS_SYS
+//  * if stored RESOLVED -> update stored time/state, publish modified
+//  * if stored ACK-XXX -> Don't change state or time, don't publish
+//  * if stored ACTIVE -> update time
+//                     -> if severity change => publish else don't publish
+//
+// Indexed by [stored state][incoming state][severity changed]
+#define T_ACK_ACTIVE    { { PUBLISH_NEVER,  false, false, true,  false }, \
+                          { PUBLISH_ALWAYS, false, false, true,  false } }
+#define T_RESOLVE       { { PUBLISH_ALWAYS, true,  true,  false, true  }, \
+                          { PUBLISH_ALWAYS, true,  true,  false, true  } }
+
+static const transition_t s_transitions [ALERT_STATE_RESOLVED + 1][2][2] = {
+    // ALERT_STATE_UNKNOWN, handled as an acknowledged alert
+    { T_ACK_ACTIVE, T_RESOLVE },
+    // ALERT_STATE_ACTIVE
+    { { { PUBLISH_IF_DUE, false, true,  true,  false },
+        { PUBLISH_ALWAYS, false, true,  true,  true  } },
+      T_RESOLVE },
+    // ALERT_STATE_ACK_WIP, ALERT_STATE_ACK_IGNORE, ALERT_STATE_ACK_PAUSE, ALERT_STATE_ACK_SILENCE
+    { T_ACK_ACTIVE, T_RESOLVE },
+    { T_ACK_ACTIVE, T_RESOLVE },
+    { T_ACK_ACTIVE, T_RESOLVE },
+    { T_ACK_ACTIVE, T_RESOLVE },
+    // ALERT_STATE_RESOLVED
+    { { { PUBLISH_ALWAYS, true,  true,  true,  true  },
+        { PUBLISH_ALWAYS, true,  true,  true,  true  } },
+      { { PUBLISH_NEVER,  false, false, false, false },
+        { PUBLISH_NEVER,  false, false, false, false } } }
+};
+
+// transition of cached alert in state 'stored' on incoming ACTIVE or RESOLVED alert
+static const transition_t &
+s_transition (alert_state_t stored, alert_state_t incoming, bool severityChanged) {
+    assert (incoming == ALERT_STATE_ACTIVE || incoming == ALERT_STATE_RESOLVED);
+    if (!alert_state_is_alert (stored))
+        stored = ALERT_STATE_UNKNOWN;
+    return s_transitions [stored]
+        [incoming == ALERT_STATE_ACTIVE ? INCOMING_ACTIVE : INCOMING_RESOLVED]
+        [severityChanged ? 1 : 0];
+}
 
-static const char *STATE_PATH = "/var/lib/fty/fty-alert-list";
-static const char *STATE_FILE = "state_file";
+// bookkeeping containers allocate their nodes from slab pools
+typedef std::unordered_map<fty_proto_t*, alert_info_t, std::hash<fty_proto_t*>, std::equal_to<fty_proto_t*>,
+        alert_pool_allocator<std::pair<fty_proto_t* const, alert_info_t>>> alert_info_map_t;
+typedef std::unordered_map<const char*, fty_proto_t*, std::hash<const char*>, std::equal_to<const char*>,
+        alert_pool_allocator<std::pair<const char* const, fty_proto_t*>>> alert_index_map_t;
 
 static zlistx_t *alerts = NULL;
-static std::map<fty_proto_t*, time_t> alertsLastSent;
+static alert_info_map_t alertsInfo;
+static alert_index_map_t alertsIndex; // identity -> cached alert
 static std::mutex alertMtx;
 static bool verbose = false;
+static bool scanFrames = false; // alert_frame_probe () passed, see s_handle_stream_scanned ()
+
+// RESOLVED alerts left undecoded in the state image at startup, see
+// s_cache_load (); an alert is either cached or here, never both
+typedef std::unordered_map<const char*, size_t, std::hash<const char*>, std::equal_to<const char*>,
+        alert_pool_allocator<std::pair<const char* const, size_t>>> alert_lazy_map_t;
+static alert_image_t *lazyImage = NULL;
+static alert_lazy_map_t lazyIndex;      // identity -> record of lazyImage
+
+// flap detection, set by FLAPPING command of the stream actor
+static int64_t flapWindow = 300;        // seconds
+static uint32_t flapTransitions = 0;    // state flips within flapWindow to damp alert, 0 - disabled
+static int64_t flapHoldDown = 120;      // seconds without a flip to release damped alert
+static size_t dampedAlerts = 0;
+static int64_t dampedNext = 0;          // earliest damped_until of damped alerts, 0 - none
+
+// keep-alive republishing of ACTIVE alerts, ordered by due time (earliest
+// on top); entries not matching keepalive_due of their alert are stale
+typedef std::pair<int64_t, fty_proto_t*> keepalive_t;
+static std::priority_queue<keepalive_t, std::vector<keepalive_t>, std::greater<keepalive_t>> keepalives;
+static size_t keepaliveRate = 50;       // keep-alive publishes per second at most, set by KEEPALIVE command
+
+// alerts still to be re-announced on ALERTS, see ANNOUNCE command
+static std::deque<fty_proto_t*> announcements;
+static size_t announceRate = 0;         // announcements per second
+static size_t announceTotal = 0;        // alerts queued by last ANNOUNCE command
+
+// checkpoints of the cache to the state file, see s_checkpoint_tick ()
+static std::atomic<size_t> checkpointChunk (128); // alerts copied per lock of the cache
+static std::vector<fty_proto_t*> alertsOrder; // cached alerts by index, alerts are never removed
+static std::atomic<size_t> dirtyCount (0);    // changes of the cache since last checkpoint
+static int64_t checkpointInterval = 0;  // seconds between checkpoints, 0 - disabled
+static size_t checkpointDirty = 0;      // changes forcing a checkpoint before the interval, 0 - never
+static int64_t checkpointLast = 0;
+static std::thread checkpointThread;
+static std::atomic<bool> checkpointBusy (false);
+static std::atomic<bool> checkpointFailed (false); // retry after the interval only
+#define CHECKPOINT_POLL_INTERVAL 1000   // ms between checks for the end of a checkpoint
+
+// messages already received are handled on shutdown for this long at most [ms]
+#define STREAM_DRAIN_TIMEOUT 2000
+static size_t journalLimit = 4 * 1024 * 1024; // journal bytes forcing a checkpoint, 0 - never
+// checkpoints write a state image, or ZPL which older versions of the agent
+// read, so that they can be rolled back to; set by STATEFORMAT command
+static std::atomic<bool> stateImage (false);
+
+// write-ahead journal of cache changes, NULL if it can't be written
+#define JOURNAL_COMMIT_INTERVAL 50      // ms between group commits while busy
+static alert_journal_t *journal = NULL;
+static int64_t journalCommitted = 0;
+
+// the mailbox actor wakes the stream actor after it changed the cache, so
+// that the journal is committed and checkpoint triggers are checked
+#define STREAM_WAKE_ENDPOINT "inproc://fty-alert-list-stream-wake"
+static zsock_t *streamWake = NULL;      // mailbox actor end, never blocks
+
+// start tracking 'alert' stored in the cache, with given identity (NULL if
+// the alert has no rule or element, it is then never found by identity)
+// returns its bookkeeping record
+static alert_info_t &
+s_alert_track (fty_proto_t *alert, const char *identity) {
+    alert_info_t &info = alertsInfo[alert];
+    info.identity = identity;
+    info.severity = alert_intern_string (fty_proto_severity (alert));
+    info.actions = alert_intern_actions (fty_proto_action (alert));
+    info.state = alert_state_from_string (fty_proto_state (alert));
+    info.last_sent = 0;
+    info.expires = 0;
+    info.keepalive_due = 0;
+    info.keepalive_pending = false;
+    info.flap_window = 0;
+    info.flap_count = 0;
+    info.flap_previous = 0;
+    info.damped_until = 0;
+    info.damped_state = info.state;
+    if (identity)
+        alertsIndex[identity] = alert;
+    alertsOrder.push_back (alert);
+    return info;
+}
+
+// bookkeeping record of cached 'alert', made by s_alert_track (); NULL if
+// it isn't tracked, which is a bug - no record is created for it here
+static alert_info_t *
+s_alert_info (fty_proto_t *alert) {
+    auto it = alertsInfo.find (alert);
+    if (it == alertsInfo.end ()) {
+        log_error ("alert (%s, %s) is not tracked", fty_proto_rule (alert), fty_proto_name (alert));
+        return NULL;
+    }
+    return &it->second;
+}
 
+// record change of cached alert (other than a refresh) for the journal and
+// checkpoints; call with alertMtx locked, so that records keep the order of
+// changes
 static void
-s_set_alert_lifetime (zhash_t *exp, fty_proto_t *msg) {
-    if (!exp || !msg) return;
+s_alert_changed (fty_proto_t *cursor) {
+    dirtyCount++;
+    if (journal)
+        alert_journal_append (journal, cursor);
+}
 
-    int64_t ttl = fty_proto_ttl (msg);
+// (re)arm TTL deadline of cached alert, alert without ttl keeps its deadline
+static void
+s_set_alert_lifetime (alert_info_t &info, int64_t ttl) {
     if (!ttl) return;
-    const char *rule = fty_proto_rule (msg);
-    if (!rule) return;
-    int64_t *time = (int64_t *) malloc (sizeof (int64_t));
-    if (!time) return;
-
-    *time = zclock_mono () / 1000 + ttl;
-    zhash_update (exp, rule, time);
-    log_debug (" ##### rule %s with ttl %" PRIi64, rule, ttl);
-    zhash_freefn (exp, rule, free);
+
+    info.expires = zclock_mono () / 1000 + ttl;
+    log_debug (" ##### alert %s with ttl %" PRIi64, info.identity, ttl);
+}
+
+// Record publish of cached alert at 'now' and schedule its keep-alive: an
+// ACTIVE alert with ttl is republished at a random point of the second
+// quarter of its ttl, so that alerts published together (e.g. loaded from
+// the state file) don't time out or get refreshed together.
+static void
+s_alert_published (fty_proto_t *cursor, alert_info_t &info, int64_t now) {
+    info.last_sent = now;
+    info.keepalive_pending = false;
+    info.keepalive_due = 0;
+    int64_t ttl = fty_proto_ttl (cursor);
+    if (info.state != ALERT_STATE_ACTIVE || ttl <= 0)
+        return;
+    info.keepalive_due = now + ttl / 4 + rand () % (ttl / 4 + 1);
+    keepalives.push (keepalive_t (info.keepalive_due, cursor));
+}
+
+// Record TTL deadline and last publish of cached alert in its copy 'copy'
+// for the state file, as wall-clock times: 'mono' and 'wall' are the
+// current zclock_mono () / 1000 and time ().
+static void
+s_alert_export_times (fty_proto_t *copy, const alert_info_t &info, int64_t mono, int64_t wall) {
+    if (info.state == ALERT_STATE_ACTIVE && info.expires)
+        fty_proto_aux_insert (copy, STATE_AUX_DEADLINE, "%" PRIi64, info.expires - mono + wall);
+    if (info.last_sent)
+        fty_proto_aux_insert (copy, STATE_AUX_LAST_SENT, "%" PRIi64, (int64_t) info.last_sent - mono + wall);
+}
+
+// Restore TTL deadline and last publish of alert loaded from the state file
+// and drop them from its aux. Deadline that passed while the agent was down
+// resolves the alert on the next TTL cleanup; ACTIVE alert without a
+// deadline (saved by an older version or replayed from the journal) gets a
+// full ttl from now. The keep-alive is scheduled from the last publish, so
+// that refreshes arriving after a restart are not all republished at once.
+static void
+s_alert_import_times (fty_proto_t *cursor, alert_info_t &info, int64_t mono, int64_t wall) {
+    zhash_t *aux = fty_proto_aux (cursor);
+    const char *deadline = aux ? (const char *) zhash_lookup (aux, STATE_AUX_DEADLINE) : NULL;
+    const char *last_sent = aux ? (const char *) zhash_lookup (aux, STATE_AUX_LAST_SENT) : NULL;
+
+    if (info.state == ALERT_STATE_ACTIVE) {
+        if (deadline)
+            info.expires = std::max ((int64_t) strtoll (deadline, NULL, 10) - wall + mono, (int64_t) 1);
+        else
+            s_set_alert_lifetime (info, fty_proto_ttl (cursor));
+    }
+    if (last_sent)
+        s_alert_published (cursor, info, (int64_t) strtoll (last_sent, NULL, 10) - wall + mono);
+
+    if (aux) {
+        zhash_delete (aux, STATE_AUX_DEADLINE);
+        zhash_delete (aux, STATE_AUX_LAST_SENT);
+    }
+}
+
+// decode RESOLVED alert with 'identity' left in the state image and cache it;
+// call with alertMtx locked
+// returns cached alert, NULL if no alert with 'identity' was left there
+static fty_proto_t *
+s_alert_materialize (const char *identity) {
+    auto lazy = lazyIndex.find (identity);
+    if (lazy == lazyIndex.end ())
+        return NULL;
+    fty_proto_t *alert = alert_image_decode (lazyImage, lazy->second);
+    lazyIndex.erase (lazy);
+    if (!alert)
+        return NULL;
+    zlistx_add_end (alerts, alert);
+    fty_proto_destroy (&alert);
+    fty_proto_t *cursor = (fty_proto_t *) zlistx_last (alerts);
+    alert_info_t &info = s_alert_track (cursor, identity);
+    s_alert_import_times (cursor, info, zclock_mono () / 1000, (int64_t) time (NULL));
+    alert_stats_add (ALERT_STATS_MATERIALIZED, 1);
+    return cursor;
+}
+
+// records of lazyImage still left there, in order; call with alertMtx locked
+static std::vector<size_t>
+s_lazy_records () {
+    std::vector<size_t> records;
+    records.reserve (lazyIndex.size ());
+    for (const auto &lazy : lazyIndex)
+        records.push_back (lazy.second);
+    std::sort (records.begin (), records.end ());
+    return records;
 }
 
+// is keep-alive of cached alert due, i.e. was it missed by s_publish_keepalives ()?
+// alert without a scheduled keep-alive is always due
 static bool
-s_alert_expired (zhash_t *exp, fty_proto_t *msg) {
-    if (!exp || !msg) return false;
+s_keepalive_due (const alert_info_t &info, int64_t now) {
+    return !info.keepalive_due || now >= info.keepalive_due;
+}
+
+// Same-severity ACTIVE re-evaluation of an ACTIVE alert, with no new
+// description or actions: only the time and the TTL deadline move.
+static void
+s_alert_refresh (fty_proto_t *cursor, alert_info_t &info, uint64_t time, int64_t ttl) {
+    fty_proto_set_time (cursor, time);
+    s_set_alert_lifetime (info, ttl);
+    alert_stats_add (ALERT_STATS_REFRESHED, 1);
+}
 
-    const char *rule = fty_proto_rule (msg);
-    if (!rule) return false;
+// count state flip of cached alert at 'now' in a sliding window of flapWindow
+// seconds, estimated from the current and the previous fixed window
+// returns number of flips within the sliding window
+static uint32_t
+s_flap_count (alert_info_t &info, int64_t now) {
+    int64_t window = now / flapWindow;
+    if (window != info.flap_window) {
+        info.flap_previous = (window == info.flap_window + 1) ? info.flap_count : 0;
+        info.flap_count = 0;
+        info.flap_window = window;
+    }
+    info.flap_count++;
+    // previous window counts by its part still covered by the sliding window
+    int64_t elapsed = now - window * flapWindow;
+    return info.flap_count + (uint32_t) (info.flap_previous * (flapWindow - elapsed) / flapWindow);
+}
 
-    int64_t *time = (int64_t *) zhash_lookup (exp, rule);
-    if (!time) {
-        return false;
+// Flap detection of cached alert which was in state 'previous' before the
+// incoming one, 'flipped' if it changed between alert and RESOLVED.
+// Alert flipping flapTransitions times within flapWindow seconds is damped:
+// nothing of it is published until it stays flapHoldDown seconds without
+// a flip, then s_release_damped_alerts () publishes the settled state.
+// Keep-alive of the state consumers already know is not held down.
+// returns whether to publish the alert, 'send' unless damped
+static bool
+s_alert_damp (alert_info_t &info, alert_state_t previous, bool flipped, bool send) {
+    if (!flapTransitions && !info.damped_until)
+        return send;
+
+    if (flipped) {
+        int64_t now = zclock_mono () / 1000;
+        uint32_t flips = s_flap_count (info, now);
+        if (!info.damped_until && flapTransitions && flips >= flapTransitions) {
+            log_info ("alert %s is flapping (%" PRIu32 " state changes), damped", info.identity, flips);
+            info.damped_state = previous;
+            dampedAlerts++;
+            alert_stats_add (ALERT_STATS_FLAPPING, 1);
+        }
+        if (info.damped_until || (flapTransitions && flips >= flapTransitions)) {
+            info.damped_until = now + flapHoldDown;
+            dampedNext = dampedNext ? std::min (dampedNext, info.damped_until) : info.damped_until;
+        }
     }
-    return (*time < zclock_mono () / 1000);
+
+    if (!send || !info.damped_until)
+        return send;
+    if (!flipped && info.state == info.damped_state)
+        return send;
+    alert_stats_add (ALERT_STATS_DAMPED, 1);
+    return false;
 }
 
+// queue all alerts not RESOLVED for re-announcing on ALERTS, 'rate' per second
 static void
-s_clear_long_time_expired (zhash_t *exp) {
-    if (!exp) return;
+s_announce_alerts (size_t rate) {
+    alertMtx.lock ();
+    announcements.clear ();
+    fty_proto_t *cursor = (fty_proto_t *) zlistx_first (alerts);
+    while (cursor) {
+        alert_info_t *info = s_alert_info (cursor);
+        if (info && info->state != ALERT_STATE_RESOLVED)
+            announcements.push_back (cursor);
+        cursor = (fty_proto_t *) zlistx_next (alerts);
+    }
+    announceRate = rate;
+    announceTotal = announcements.size ();
+    alertMtx.unlock ();
+    log_info ("announcing %zu alerts, %zu per second", announceTotal, rate);
+}
 
-    zlist_t *keys = zhash_keys (exp);
+// publish copies of cached alerts on ALERTS and destroy them
+static void
+s_publish_copies (mlm_client_t *client, std::vector<fty_proto_t *> &copies) {
+    for (fty_proto_t *alert : copies) {
+        char *subject = zsys_sprintf ("%s/%s@%s",
+                fty_proto_rule (alert), fty_proto_severity (alert), fty_proto_name (alert));
+        zmsg_t *encoded = fty_proto_encode (&alert);
+        if (!subject || !encoded || mlm_client_send (client, subject, &encoded) != 0) {
+            log_error ("mlm_client_send (subject = '%s') failed", subject ? subject : "");
+            zmsg_destroy (&encoded);
+        }
+        else {
+            alert_stats_add (ALERT_STATS_PUBLISHED, 1);
+        }
+        zstr_free (&subject);
+    }
+    copies.clear ();
+}
+
+// release damped alerts whose hold-down is over and publish their settled
+// state, if consumers of ALERTS don't know it yet
+static void
+s_release_damped_alerts (mlm_client_t *client) {
     int64_t now = zclock_mono () / 1000;
+    if (!dampedAlerts || now < dampedNext)
+        return;
 
-    const char *rule = (char *) zlist_first (keys);
-    while (rule) {
-        int64_t *time = (int64_t *) zhash_lookup (exp, rule);
-        if (*time < now - 3600) zhash_delete (exp, rule);
-        rule = (char *) zlist_next (keys);
+    std::vector<fty_proto_t *> settled;
+    alertMtx.lock ();
+    dampedNext = 0;
+    for (auto &it : alertsInfo) {
+        alert_info_t &info = it.second;
+        if (!info.damped_until)
+            continue;
+        if (info.damped_until > now) {
+            dampedNext = dampedNext ? std::min (dampedNext, info.damped_until) : info.damped_until;
+            continue;
+        }
+        info.damped_until = 0;
+        info.flap_count = 0;
+        info.flap_previous = 0;
+        dampedAlerts--;
+        log_info ("alert %s settled in %s, released", info.identity, alert_state_string (info.state));
+        if (info.state != info.damped_state) {
+            fty_proto_t *copy = fty_proto_dup (it.first);
+            if (copy) {
+                settled.push_back (copy);
+                s_alert_published (it.first, info, now);
+            }
+        }
     }
-    zlist_destroy (&keys);
+    alertMtx.unlock ();
+
+    s_publish_copies (client, settled);
 }
 
+// Re-announce next queued alerts, at most announceRate of them per second.
+// Alerts resolved or damped in the meantime were announced by then already.
 static void
-s_resolve_expired_alerts (zhash_t *exp) {
-    if (!exp || !alerts) return;
+s_publish_announcements (mlm_client_t *client) {
+    static int64_t second = 0;
+    static size_t sent = 0;
+
+    if (announcements.empty ())
+        return;
+    int64_t now = zclock_mono () / 1000;
+    if (now != second) {
+        second = now;
+        sent = 0;
+    }
 
+    std::vector<fty_proto_t *> announced;
+    alertMtx.lock ();
+    while (!announcements.empty () && sent < announceRate) {
+        fty_proto_t *cursor = announcements.front ();
+        announcements.pop_front ();
+        alert_info_t *info = s_alert_info (cursor);
+        if (!info || info->state == ALERT_STATE_RESOLVED || info->damped_until)
+            continue;
+        fty_proto_t *copy = fty_proto_dup (cursor);
+        if (!copy)
+            continue;
+        announced.push_back (copy);
+        s_alert_published (cursor, *info, now);
+        alert_stats_add (ALERT_STATS_ANNOUNCED, 1);
+        sent++;
+    }
+    size_t left = announcements.size ();
+    alertMtx.unlock ();
+
+    s_publish_copies (client, announced);
+    if (!left)
+        log_info ("announced %zu alerts", announceTotal);
+    else
+    if (verbose)
+        log_debug ("announced %zu of %zu alerts", announceTotal - left, announceTotal);
+}
+
+// Republish ACTIVE alerts whose keep-alive is due and which were refreshed
+// since their last publish, at most keepaliveRate of them per second; the
+// rest waits for the next tick. Alerts not refreshed in time aren't kept
+// alive, they time out as the engine meant.
+static void
+s_publish_keepalives (mlm_client_t *client) {
+    static int64_t second = 0;
+    static size_t sent = 0;
+
+    int64_t now = zclock_mono () / 1000;
+    if (now != second) {
+        second = now;
+        sent = 0;
+    }
+
+    std::vector<fty_proto_t *> due;
+    alertMtx.lock ();
+    while (!keepalives.empty () && keepalives.top ().first <= now && sent < keepaliveRate) {
+        keepalive_t keepalive = keepalives.top ();
+        keepalives.pop ();
+        auto it = alertsInfo.find (keepalive.second);
+        if (it == alertsInfo.end () || it->second.keepalive_due != keepalive.first)
+            continue;
+        alert_info_t &info = it->second;
+        info.keepalive_due = 0;
+        if (!info.keepalive_pending || info.state != ALERT_STATE_ACTIVE)
+            continue;
+        if (info.damped_until && info.state != info.damped_state)
+            continue;
+        fty_proto_t *copy = fty_proto_dup (keepalive.second);
+        if (!copy)
+            continue;
+        due.push_back (copy);
+        s_alert_published (keepalive.second, info, now);
+        alert_stats_add (ALERT_STATS_KEEPALIVES, 1);
+        sent++;
+    }
+    alertMtx.unlock ();
+
+    s_publish_copies (client, due);
+}
+
+static void
+s_resolve_expired_alerts () {
+    if (!alerts) return;
+
+    int64_t now = zclock_mono () / 1000;
     alertMtx.lock ();
     fty_proto_t *cursor = (fty_proto_t *) zlistx_first (alerts);
     while (cursor) {
-        if (s_alert_expired (exp, cursor) && streq (fty_proto_state (cursor), "ACTIVE")) {
+        alert_info_t *tracked = s_alert_info (cursor);
+        if (!tracked) {
+            cursor = (fty_proto_t *) zlistx_next (alerts);
+            continue;
+        }
+        alert_info_t &info = *tracked;
+        if (info.state == ALERT_STATE_ACTIVE && info.expires && info.expires < now) {
             fty_proto_set_state (cursor, "%s", "RESOLVED");
+            info.state = ALERT_STATE_RESOLVED;
             std::string new_desc = JSONIFY ("%s - %s", fty_proto_description (cursor), "TTLCLEANUP");
             fty_proto_set_description (cursor, "%s", new_desc.c_str ());
+            s_alert_changed (cursor);
 
             if (verbose) {
                 log_debug ("s_resolve_expired_alerts: resolving alert");
@@ -111,12 +598,79 @@ s_resolve_expired_alerts (zhash_t *exp) {
         cursor = (fty_proto_t *) zlistx_next (alerts);
     }
     alertMtx.unlock ();
+}
+
+// Handle alert coming from _ALERTS_SYS without decoding it, when it doesn't
+// bring anything the cached alert would need a decoded copy for: the alert
+// is cached already, severity and actions don't change, state and creation
+// time stay, and nothing is to be published.
+// returns true if the message was handled (and destroyed)
 
-    s_clear_long_time_expired (exp);
+static bool
+s_handle_stream_scanned (zmsg_t **msg_p, const alert_frame_t &frame) {
+    // string fields are at most 255 bytes long
+    char rule [256], name [256], buffer [256];
+    alert_state_t state = alert_state_from_string (alert_span_copy (frame.state, buffer, sizeof (buffer)));
+    if (state != ALERT_STATE_ACTIVE && state != ALERT_STATE_RESOLVED)
+        return false;
+    const char *identity = alert_intern_identity_lookup (
+        alert_span_copy (frame.rule, rule, sizeof (rule)),
+        alert_span_copy (frame.name, name, sizeof (name)));
+    if (!identity)
+        return false;
+    const char *severity = alert_intern_string (alert_span_copy (frame.severity, buffer, sizeof (buffer)));
+    const char *actions = alert_intern_actions_frame (&frame);
+
+    std::lock_guard<std::mutex> lock (alertMtx);
+    auto index = alertsIndex.find (identity);
+    if (index == alertsIndex.end ())
+        return false;
+    fty_proto_t *cursor = index->second;
+    alert_info_t *tracked = s_alert_info (cursor);
+    if (!tracked)
+        return false;
+    alert_info_t &info = *tracked;
+    if (severity != info.severity || actions != info.actions)
+        return false;
+
+    const transition_t &transition = s_transition (info.state, state, false);
+    if (transition.take_state || transition.reset_ctime)
+        return false;
+    if (transition.publish == PUBLISH_ALWAYS)
+        return false;
+    if (transition.publish == PUBLISH_IF_DUE) {
+        if (s_keepalive_due (info, zclock_mono () / 1000))
+            return false;
+        info.keepalive_pending = true;
+    }
+
+    bool sameDescription = alert_span_streq (frame.description, fty_proto_description (cursor));
+    if (info.state == ALERT_STATE_ACTIVE && state == ALERT_STATE_ACTIVE && sameDescription) {
+        s_alert_refresh (cursor, info, frame.time, frame.ttl);
+    }
+    else {
+        if (transition.take_description) {
+            s_set_alert_lifetime (info, frame.ttl);
+            if (!sameDescription)
+                fty_proto_set_description (cursor, "%.*s", (int) frame.description.size, frame.description.data);
+        }
+        if (transition.take_time) {
+            fty_proto_set_time (cursor, frame.time);
+        }
+        if (transition.take_time || (transition.take_description && !sameDescription))
+            s_alert_changed (cursor);
+    }
+
+    if (verbose)
+        log_debug ("s_handle_stream_scanned (): %s (%s/%s) handled without decoding",
+            rule, severity, alert_state_string (state));
+    alert_stats_add (ALERT_STATS_DECODE_SKIPPED, 1);
+    zmsg_destroy (msg_p);
+    return true;
 }
 
 static void
-s_handle_stream_deliver (mlm_client_t *client, zmsg_t** msg_p, zhash_t *expirations) {
+s_handle_stream_deliver (mlm_client_t *client, zmsg_t** msg_p) {
     assert (client);
     assert (msg_p);
 
@@ -125,7 +679,14 @@ s_handle_stream_deliver (mlm_client_t *client, zmsg_t** msg_p, zhash_t *expirati
         return;
     }
 
-    fty_proto_t *newAlert = fty_proto_decode (msg_p);
+    alert_stats_add (ALERT_STATS_RECEIVED, 1);
+    // scanned message stays in *msg_p, to be forwarded as is
+    alert_frame_t frame;
+    bool scanned = scanFrames && alert_frame_scan (&frame, *msg_p) == 0;
+    if (scanned && s_handle_stream_scanned (msg_p, frame))
+        return;
+
+    fty_proto_t *newAlert = scanned ? alert_frame_decode (&frame) : fty_proto_decode (msg_p);
     if (!newAlert || fty_proto_id (newAlert) != FTY_PROTO_ALERT) {
         fty_proto_destroy (&newAlert);
         log_warning ("s_handle_stream_deliver (): Message not FTY_PROTO_ALERT.");
@@ -133,8 +694,8 @@ s_handle_stream_deliver (mlm_client_t *client, zmsg_t** msg_p, zhash_t *expirati
     }
 
     // handle *only* ACTIVE or RESOLVED alerts
-    if (!streq (fty_proto_state (newAlert), "ACTIVE") &&
-            !streq (fty_proto_state (newAlert), "RESOLVED")) {
+    alert_state_t state = alert_state_from_string (fty_proto_state (newAlert));
+    if (state != ALERT_STATE_ACTIVE && state != ALERT_STATE_RESOLVED) {
         fty_proto_destroy (&newAlert);
         log_warning ("s_handle_stream_deliver (): Message state not ACTIVE or RESOLVED. Not publishing any further.");
         return;
@@ -145,122 +706,140 @@ s_handle_stream_deliver (mlm_client_t *client, zmsg_t** msg_p, zhash_t *expirati
         fty_proto_print (newAlert);
     }
 
+    const char *identity = alert_intern_identity (fty_proto_rule (newAlert), fty_proto_name (newAlert));
+    if (!identity) {
+        fty_proto_destroy (&newAlert);
+        log_warning ("s_handle_stream_deliver (): Message without rule or element. Not publishing any further.");
+        return;
+    }
+
     alertMtx.lock ();
 
-    fty_proto_t *cursor = (fty_proto_t *) zlistx_first (alerts);
-    bool found = false;
-    while (cursor) {
-        if (alert_id_comparator (cursor, newAlert) == 0) {
-            found = true;
-            break;
-        }
-        cursor = (fty_proto_t *) zlistx_next (alerts);
+    fty_proto_t *cursor = NULL;
+    alert_info_t *info = NULL;
+    auto index = alertsIndex.find (identity);
+    if (index != alertsIndex.end ())
+        cursor = index->second;
+    else
+        cursor = s_alert_materialize (identity);
+    if (cursor && !(info = s_alert_info (cursor))) {
+        alertMtx.unlock ();
+        fty_proto_destroy (&newAlert);
+        return;
     }
 
     bool send = true; // default, publish
+    bool changed = true;
 
-    if (!found) {
+    if (!cursor) {
         // Record creation time
         fty_proto_aux_insert (newAlert, "ctime", "%" PRIu64, fty_proto_time (newAlert));
 
         zlistx_add_end (alerts, newAlert);
         cursor = (fty_proto_t *) zlistx_last (alerts);
-        alertsLastSent[cursor] = 0;
-        s_set_alert_lifetime (expirations, newAlert);
+        info = &s_alert_track (cursor, identity);
+        s_set_alert_lifetime (*info, fty_proto_ttl (newAlert));
     }
     else {
-        // Append creation time to new alert
-        fty_proto_aux_insert (newAlert, "ctime", "%" PRIu64, fty_proto_aux_number (cursor, "ctime", 0));
-
-        bool sameSeverity = streq (fty_proto_severity (newAlert), fty_proto_severity (cursor));
-        fty_proto_set_severity (cursor, "%s", fty_proto_severity (newAlert));
-
-        // Wasn't specified, but common sense applied, it should be:
-        // RESOLVED comes from _ALERTS_SYS
-        //  * if stored !RESOLVED -> update stored time/state, publish original
-        //  * if stored RESOLVED -> don't update stored time, don't publish original
-        //
-        //  ACTIVE comes form _ALERTS_SYS
-        //  * if stored RESOLVED -> update stored time/state, publish modified
-        //  * if stored ACK-XXX -> Don't change state or time, don't publish
-        //  * if stored ACTIVE -> update time
-        //                     -> if severity change => publish else don't publish
-
-        if (streq (fty_proto_state (newAlert), "RESOLVED")) {
-            if (!streq (fty_proto_state (cursor), "RESOLVED")) {
-                // Record resolved time
-                fty_proto_aux_insert (cursor,   "ctime", "%" PRIu64, fty_proto_time (newAlert));
-                fty_proto_aux_insert (newAlert, "ctime", "%" PRIu64, fty_proto_time (newAlert));
-
-                fty_proto_set_state (cursor, "%s", fty_proto_state (newAlert));
-                fty_proto_set_time (cursor, fty_proto_time (newAlert));
-                fty_proto_set_metadata (cursor, "%s", fty_proto_metadata (newAlert));
+        const char *severity = alert_intern_string (fty_proto_severity (newAlert));
+        bool sameSeverity = (severity == info->severity);
+        const char *actionSet = alert_intern_actions (fty_proto_action (newAlert));
+        bool sameDescription = streq (fty_proto_description (newAlert), fty_proto_description (cursor));
+
+        const transition_t &transition = s_transition (info->state, state, !sameSeverity);
+        alert_state_t previous = info->state;
+
+        if (info->state == ALERT_STATE_ACTIVE && state == ALERT_STATE_ACTIVE &&
+                sameSeverity && sameDescription && actionSet == info->actions) {
+            s_alert_refresh (cursor, *info, fty_proto_time (newAlert), fty_proto_ttl (newAlert));
+            changed = false;
+        }
+        else {
+            changed = !sameSeverity || (transition.take_description && !sameDescription) ||
+                transition.reset_ctime || transition.take_time || transition.take_state ||
+                actionSet != info->actions;
+            if (!sameSeverity) {
+                fty_proto_set_severity (cursor, "%s", severity);
+                info->severity = severity;
             }
-            else {
-                send = false;
+            if (transition.take_description) {
+                s_set_alert_lifetime (*info, fty_proto_ttl (newAlert));
+                //copy the description only if the alert is active
+                if (!sameDescription)
+                    fty_proto_set_description (cursor, "%s", fty_proto_description (newAlert));
             }
-        }
-        else { // state (newAlert) == ACTIVE
-            s_set_alert_lifetime (expirations, newAlert);
-
-            //copy the description only if the alert is active
-            fty_proto_set_description (cursor, "%s", fty_proto_description (newAlert));
-
-            if (streq (fty_proto_state (cursor), "RESOLVED")) {
-                // Record reactivation time
-                fty_proto_aux_insert (cursor,   "ctime", "%" PRIu64, fty_proto_time (newAlert));
-                fty_proto_aux_insert (newAlert, "ctime", "%" PRIu64, fty_proto_time (newAlert));
-
+            if (transition.reset_ctime) {
+                // Record resolved/reactivation time or creation time of new severity
+                fty_proto_aux_insert (cursor, "ctime", "%" PRIu64, fty_proto_time (newAlert));
+            }
+            if (transition.take_time) {
                 fty_proto_set_time (cursor, fty_proto_time (newAlert));
+            }
+            if (transition.take_state) {
                 fty_proto_set_state (cursor, "%s", fty_proto_state (newAlert));
                 fty_proto_set_metadata (cursor, "%s", fty_proto_metadata (newAlert));
+                info->state = state;
             }
-            else if (!streq (fty_proto_state (cursor), "ACTIVE")) {
-                // fty_proto_state (cursor) ==  ACK-XXXX
-                if (sameSeverity) {
-                    send = false;
-                }
-            }
-            else { // state (cursor) == ACTIVE
-                fty_proto_set_time (cursor, fty_proto_time (newAlert));
-
-                // Always active and same severity => don't publish...
-                if (sameSeverity) {
-                    // ... if we're not at risk of timing out
-                    time_t lastSent = alertsLastSent[cursor];
-                    if ((zclock_mono ()/1000) < (lastSent + fty_proto_ttl (cursor)/2)) {
-                        send = false;
-                    }
+            //let's do the action at the end of the processing
+            if (actionSet != info->actions) {
+                zlist_t *actions;
+                if (NULL == fty_proto_action (newAlert)) {
+                    actions = zlist_new ();
+                    zlist_autofree (actions);
                 }
-                // Severity changed => update creation time
                 else {
-                    fty_proto_aux_insert (cursor,   "ctime", "%" PRIu64, fty_proto_time (newAlert));
-                    fty_proto_aux_insert (newAlert, "ctime", "%" PRIu64, fty_proto_time (newAlert));
+                    actions = zlist_dup (fty_proto_action (newAlert));
                 }
+                fty_proto_set_action (cursor, &actions);
+                info->actions = actionSet;
             }
         }
 
-        //let's do the action at the end of the processing
-        zlist_t *actions;
-        if (NULL == fty_proto_action (newAlert)) {
-            actions = zlist_new ();
-            zlist_autofree (actions);
+        if (transition.publish == PUBLISH_NEVER) {
+            send = false;
         }
-        else {
-            actions = zlist_dup (fty_proto_action (newAlert));
+        else
+        if (transition.publish == PUBLISH_IF_DUE) {
+            // Always active and same severity => don't publish, keep-alive is scheduled
+            if (!s_keepalive_due (*info, zclock_mono () / 1000)) {
+                info->keepalive_pending = true;
+                send = false;
+            }
         }
-        fty_proto_set_action (cursor, &actions);
+
+        send = s_alert_damp (*info, previous, transition.take_state, send);
     }
 
+    // Published alert carries creation time of the cached one
+    uint64_t ctime = send ? fty_proto_aux_number (cursor, "ctime", 0) : 0;
+    if (changed)
+        s_alert_changed (cursor);
+
     alertMtx.unlock ();
 
     if (send) {
         log_info("send %s (%s/%s)",
             fty_proto_rule(newAlert), fty_proto_severity(newAlert), fty_proto_state(newAlert));
 
-        fty_proto_t *alert_dup = fty_proto_dup (newAlert);
-        zmsg_t *encoded = fty_proto_encode (&alert_dup);
-        fty_proto_destroy (&alert_dup);
+        zmsg_t *encoded = NULL;
+        if (scanned) {
+            // forward the received frame, with ctime spliced in its aux when it differs
+            char value [32];
+            snprintf (value, sizeof (value), "%" PRIu64, ctime);
+            alert_span_t received;
+            if (alert_frame_aux_find (&frame, "ctime", &received) && alert_span_streq (received, value)) {
+                encoded = *msg_p;
+                *msg_p = NULL;
+            }
+            else {
+                encoded = alert_frame_encode_aux (&frame, "ctime", value);
+            }
+        }
+        else {
+            // newAlert isn't needed any more, encode it rather than a copy
+            fty_proto_aux_insert (newAlert, "ctime", "%" PRIu64, ctime);
+            encoded = fty_proto_encode (&newAlert);
+        }
         assert (encoded);
 
         int rv = mlm_client_send (client, mlm_client_subject (client), &encoded);
@@ -270,7 +849,10 @@ s_handle_stream_deliver (mlm_client_t *client, zmsg_t** msg_p, zhash_t *expirati
             log_error ("mlm_client_send (subject = '%s') failed", mlm_client_subject (client));
         }
         else { // Update last sent time
-            alertsLastSent[cursor] = zclock_mono () / 1000;
+            alert_stats_add (ALERT_STATS_PUBLISHED, 1);
+            alertMtx.lock ();
+            s_alert_published (cursor, *info, zclock_mono () / 1000);
+            alertMtx.unlock ();
         }
     }
 
@@ -297,11 +879,40 @@ s_send_error_response (mlm_client_t *client, const char *subject, const char *re
     }
 }
 
+// append 'alert' to reply of LIST request and destroy it
+static void
+s_list_append (zmsg_t *reply, fty_proto_t **alert_p) {
+    zmsg_t *result = fty_proto_encode (alert_p);
+
+    /* Note: the CZMQ_VERSION_MAJOR comparison below actually assumes versions
+     * we know and care about - v3.0.2 (our legacy default, already obsoleted
+     * by upstream), and v4.x that is in current upstream master. If the API
+     * evolves later (incompatibly), these macros will need to be amended.
+     */
+    zframe_t *frame = NULL;
+    // FIXME: should we check and assert (nbytes>0) here, for both API versions,
+    // as we do in other similar cases?
+#if CZMQ_VERSION_MAJOR == 3
+    byte *buffer = NULL;
+    size_t nbytes = zmsg_encode (result, &buffer);
+    frame = zframe_new ((void *) buffer, nbytes);
+    free (buffer);
+    buffer = NULL;
+#else
+    frame = zmsg_encode (result);
+#endif
+    assert (frame);
+    zmsg_destroy (&result);
+    zmsg_append (reply, &frame);
+    //FIXME: Should we zframe_destroy (&frame) here as we do in other similar cases?
+}
+
 static void
 s_handle_rfc_alerts_list (mlm_client_t *client, zmsg_t **msg_p) {
     assert (client);
     assert (msg_p && *msg_p);
     assert (alerts);
+    alert_stats_add (ALERT_STATS_LIST_REQUESTS, 1);
 
     zmsg_t *msg = *msg_p;
     char *command = zmsg_popstr (msg);
@@ -334,7 +945,8 @@ s_handle_rfc_alerts_list (mlm_client_t *client, zmsg_t **msg_p) {
 
     char *state = zmsg_popstr (msg);
     zmsg_destroy (msg_p);
-    if (!state || !is_list_request_state (state)) {
+    alert_state_t requestState = alert_state_from_string (state);
+    if (requestState == ALERT_STATE_UNKNOWN) {
         free (correlation_id);
         correlation_id = NULL;
         free (state);
@@ -355,34 +967,25 @@ s_handle_rfc_alerts_list (mlm_client_t *client, zmsg_t **msg_p) {
     alertMtx.lock ();
     fty_proto_t *cursor = (fty_proto_t *) zlistx_first (alerts);
     while (cursor) {
-        if (is_state_included (state, fty_proto_state (cursor))) {
+        alert_info_t *info = s_alert_info (cursor);
+        if (info && alert_state_included (requestState, info->state)) {
             fty_proto_t *duplicate = fty_proto_dup (cursor);
-            zmsg_t *result = fty_proto_encode (&duplicate);
-
-            /* Note: the CZMQ_VERSION_MAJOR comparison below actually assumes versions
-             * we know and care about - v3.0.2 (our legacy default, already obsoleted
-             * by upstream), and v4.x that is in current upstream master. If the API
-             * evolves later (incompatibly), these macros will need to be amended.
-             */
-            zframe_t *frame = NULL;
-            // FIXME: should we check and assert (nbytes>0) here, for both API versions,
-            // as we do in other similar cases?
-#if CZMQ_VERSION_MAJOR == 3
-            byte *buffer = NULL;
-            size_t nbytes = zmsg_encode (result, &buffer);
-            frame = zframe_new ((void *) buffer, nbytes);
-            free (buffer);
-            buffer = NULL;
-#else
-            frame = zmsg_encode (result);
-#endif
-            assert (frame);
-            zmsg_destroy (&result);
-            zmsg_append (reply, &frame);
-            //FIXME: Should we zframe_destroy (&frame) here as we do in other similar cases?
+            s_list_append (reply, &duplicate);
         }
         cursor = (fty_proto_t *) zlistx_next (alerts);
     }
+    // alerts left in the state image are decoded for the reply only
+    if (lazyImage && alert_state_included (requestState, ALERT_STATE_RESOLVED)) {
+        for (size_t record : s_lazy_records ()) {
+            fty_proto_t *alert = alert_image_decode (lazyImage, record);
+            if (!alert)
+                continue;
+            zhash_t *aux = fty_proto_aux (alert);
+            if (aux)
+                zhash_delete (aux, STATE_AUX_LAST_SENT);
+            s_list_append (reply, &alert);
+        }
+    }
     alertMtx.unlock ();
 
     if (mlm_client_sendto (client, mlm_client_sender (client), RFC_ALERTS_LIST_SUBJECT, NULL, 5000, &reply) != 0) {
@@ -400,6 +1003,7 @@ s_handle_rfc_alerts_acknowledge (mlm_client_t *client, zmsg_t **msg_p) {
     assert (client);
     assert (msg_p);
     assert (alerts);
+    alert_stats_add (ALERT_STATS_ACK_REQUESTS, 1);
 
     zmsg_t *msg = *msg_p;
     if (!msg) {
@@ -432,7 +1036,8 @@ s_handle_rfc_alerts_acknowledge (mlm_client_t *client, zmsg_t **msg_p) {
     }
     zmsg_destroy (&msg);
     // check 'state'
-    if (!is_acknowledge_request_state (state)) {
+    alert_state_t requestState = alert_state_from_string (state);
+    if (requestState != ALERT_STATE_ACTIVE && !alert_state_is_acknowledge (requestState)) {
         log_warning (
                 "state '%s' is not an acknowledge request state according to protocol '%s'.",
                 state, RFC_ALERTS_ACKNOWLEDGE_SUBJECT);
@@ -446,17 +1051,17 @@ s_handle_rfc_alerts_acknowledge (mlm_client_t *client, zmsg_t **msg_p) {
             "s_handle_rfc_alerts_acknowledge (): rule == '%s' element == '%s' state == '%s'",
             rule, element, state);
     // check ('rule', 'element') pair
+    const char *identity = alert_intern_identity_lookup (rule, element);
     alertMtx.lock ();
-    fty_proto_t *cursor = (fty_proto_t *) zlistx_first (alerts);
-    int found = 0;
-    while (cursor) {
-        if (is_alert_identified (cursor, rule, element)) {
-            found = 1;
-            break;
-        }
-        cursor = (fty_proto_t *) zlistx_next (alerts);
+    fty_proto_t *cursor = NULL;
+    if (identity) {
+        auto index = alertsIndex.find (identity);
+        if (index != alertsIndex.end ())
+            cursor = index->second;
     }
-    if (found == 0) {
+    // RESOLVED alert left in the state image
+    bool lazy = !cursor && identity && lazyIndex.count (identity);
+    if (!cursor && !lazy) {
         zstr_free (&rule);
         zstr_free (&element);
         zstr_free (&state);
@@ -464,7 +1069,8 @@ s_handle_rfc_alerts_acknowledge (mlm_client_t *client, zmsg_t **msg_p) {
         alertMtx.unlock ();
         return;
     }
-    if (streq (fty_proto_state (cursor), "RESOLVED")) {
+    alert_info_t *tracked = lazy ? NULL : s_alert_info (cursor);
+    if (!tracked || tracked->state == ALERT_STATE_RESOLVED) {
         zstr_free (&rule);
         zstr_free (&element);
         zstr_free (&state);
@@ -472,11 +1078,17 @@ s_handle_rfc_alerts_acknowledge (mlm_client_t *client, zmsg_t **msg_p) {
         alertMtx.unlock ();
         return;
     }
+    alert_info_t &info = *tracked;
     // change stored alert state, don't change timestamp
     log_debug (
             "s_handle_rfc_alerts_acknowledge (): Changing state of (%s, %s) to %s",
             fty_proto_rule (cursor), fty_proto_name (cursor), state);
     fty_proto_set_state (cursor, "%s", state);
+    info.state = requestState;
+    s_alert_changed (cursor);
+    // acknowledge is published even for damped alert
+    if (info.damped_until)
+        info.damped_state = requestState;
 
     zmsg_t *reply = zmsg_new ();
     zmsg_addstr (reply, "OK");
@@ -528,6 +1140,35 @@ s_handle_rfc_alerts_acknowledge (mlm_client_t *client, zmsg_t **msg_p) {
     zstr_free (&subject);
 }
 
+// RELOAD - reread the configuration file. The request is passed to the
+// owner of the mailbox actor, the reply doesn't wait for the reload.
+static void
+s_handle_rfc_alerts_config (mlm_client_t *client, zmsg_t **msg_p) {
+    assert (client);
+    assert (msg_p && *msg_p);
+
+    char *command = zmsg_popstr (*msg_p);
+    zmsg_destroy (msg_p);
+    if (!command || !streq (command, "RELOAD")) {
+        s_send_error_response (client, RFC_ALERTS_CONFIG_SUBJECT, "BAD_COMMAND");
+        zstr_free (&command);
+        return;
+    }
+    zstr_free (&command);
+
+    log_info ("configuration reload requested by %s", mlm_client_sender (client));
+    if (mailboxPipe)
+        zstr_send (mailboxPipe, "RELOAD");
+
+    zmsg_t *reply = zmsg_new ();
+    zmsg_addstr (reply, "OK");
+    if (mlm_client_sendto (client, mlm_client_sender (client), RFC_ALERTS_CONFIG_SUBJECT, NULL, 5000, &reply) != 0) {
+        zmsg_destroy (&reply);
+        log_error ("mlm_client_sendto (sender = '%s', subject = '%s', timeout = '5000') failed.",
+                mlm_client_sender (client), RFC_ALERTS_CONFIG_SUBJECT);
+    }
+}
+
 static void
 s_handle_mailbox_deliver (mlm_client_t *client, zmsg_t** msg_p) {
     assert (client);
@@ -538,6 +1179,10 @@ s_handle_mailbox_deliver (mlm_client_t *client, zmsg_t** msg_p) {
         s_handle_rfc_alerts_list (client, msg_p);
     } else if (streq (mlm_client_subject (client), RFC_ALERTS_ACKNOWLEDGE_SUBJECT)) {
         s_handle_rfc_alerts_acknowledge (client, msg_p);
+        if (streamWake)
+            zsock_signal (streamWake, 0);
+    } else if (streq (mlm_client_subject (client), RFC_ALERTS_CONFIG_SUBJECT)) {
+        s_handle_rfc_alerts_config (client, msg_p);
     } else {
         std::string err = TRANSLATE_ME ("UNKNOWN_PROTOCOL");
         s_send_error_response (client, mlm_client_subject (client), err.c_str ());
@@ -547,23 +1192,250 @@ s_handle_mailbox_deliver (mlm_client_t *client, zmsg_t** msg_p) {
     }
 }
 
+// Write snapshot of the cache taken at 'dirty' changes to the state file.
+// Runs on checkpointThread: alerts are copied checkpointChunk at a time, so
+// that ingest waits for one chunk at most, whatever the size of the cache.
+// Each alert is copied consistently, alerts changed during the copy may be
+// taken before or after the change, which the journal replays either way.
+// The journal is folded into the snapshot once it's saved.
+static void
+s_checkpoint (size_t dirty) {
+    if (journal)
+        alert_journal_rotate (journal);
+    int64_t start = zclock_usecs ();
+    int64_t longest = 0;
+    zlistx_t *snapshot = zlistx_new ();
+    zlistx_set_destructor (snapshot, (czmq_destructor *) fty_proto_destroy);
+
+    size_t index = 0;
+    bool done = false;
+    std::vector<size_t> lazyRecords;
+    size_t chunk = std::max (checkpointChunk.load (), (size_t) 1);
+    while (!done) {
+        alertMtx.lock ();
+        int64_t locked = zclock_usecs ();
+        size_t end = std::min (index + chunk, alertsOrder.size ());
+        int64_t mono = zclock_mono () / 1000;
+        int64_t wall = (int64_t) time (NULL);
+        for (; index < end; index++) {
+            fty_proto_t *copy = fty_proto_dup (alertsOrder [index]);
+            auto it = alertsInfo.find (alertsOrder [index]);
+            if (copy && it != alertsInfo.end ())
+                s_alert_export_times (copy, it->second, mono, wall);
+            zlistx_add_end (snapshot, copy);
+        }
+        done = index >= alertsOrder.size ();
+        // alerts left in the state image, copied as they are below
+        if (done)
+            lazyRecords = s_lazy_records ();
+        longest = std::max (longest, zclock_usecs () - locked);
+        alertMtx.unlock ();
+    }
+
+    // snapshot is encoded and released before the write
+    size_t count = zlistx_size (snapshot) + lazyRecords.size ();
+    int rv = -1;
+    if (!stateImage) {
+        // alerts left in the state image are decoded for ZPL
+        bool decoded = true;
+        for (size_t index : lazyRecords) {
+            fty_proto_t *alert = alert_image_decode (lazyImage, index);
+            if (!alert || !zlistx_add_end (snapshot, alert)) {
+                fty_proto_destroy (&alert);
+                decoded = false;
+                break;
+            }
+        }
+        if (decoded)
+            rv = alert_save_state_zpl (snapshot, statePath.c_str (), stateFile.c_str ());
+    }
+    else {
+        zchunk_t *image = alert_image_encode_records (snapshot, lazyImage, lazyRecords.data (), lazyRecords.size ());
+        if (image) {
+            zlistx_destroy (&snapshot);
+            rv = alert_image_write (image, statePath.c_str (), stateFile.c_str ());
+            zchunk_destroy (&image);
+        }
+        else
+        if (lazyRecords.empty ())
+            rv = alert_save_state (snapshot, statePath.c_str (), stateFile.c_str (), false);
+    }
+    zlistx_destroy (&snapshot);
+
+    if (rv != 0) {
+        dirtyCount += dirty;
+        checkpointFailed = true;
+        log_error ("checkpoint of %zu alerts failed", count);
+    }
+    else {
+        if (journal)
+            alert_journal_folded (journal);
+        checkpointFailed = false;
+        log_info ("checkpoint: %zu alerts, %zu changes in %" PRIi64 " ms, longest pause %" PRIi64 " us",
+            count, dirty, (zclock_usecs () - start) / 1000, longest);
+    }
+    alert_stats_add (ALERT_STATS_CHECKPOINTS, 1);
+    checkpointBusy = false;
+}
+
+// wait for checkpoint in progress, if any
+static void
+s_checkpoint_join () {
+    if (checkpointThread.joinable ())
+        checkpointThread.join ();
+}
+
+// Start checkpoint in the background when the cache changed and
+// checkpointInterval passed since the previous one, when checkpointDirty
+// changes piled up or when the journal grew over journalLimit bytes.
+// Failed checkpoint is retried after the interval (a minute at least).
+static void
+s_checkpoint_tick () {
+    if (checkpointBusy)
+        return;
+    s_checkpoint_join ();
+
+    size_t dirty = dirtyCount;
+    int64_t now = zclock_mono () / 1000;
+    bool due = (checkpointInterval && dirty && now - checkpointLast >= checkpointInterval) ||
+        (checkpointDirty && dirty >= checkpointDirty) ||
+        (journal && journalLimit && alert_journal_size (journal) >= journalLimit);
+    if (!due)
+        return;
+    if (checkpointFailed && now - checkpointLast < std::max (checkpointInterval, (int64_t) 60))
+        return;
+
+    checkpointLast = now;
+    dirtyCount -= dirty;
+    checkpointBusy = true;
+    checkpointThread = std::thread (s_checkpoint, dirty);
+}
+
+// group commit of the journal: when the actor is idle, or every
+// JOURNAL_COMMIT_INTERVAL ms while it's busy
+static void
+s_journal_tick (bool idle) {
+    if (!journal || !alert_journal_pending (journal))
+        return;
+    int64_t now = zclock_mono ();
+    if (!idle && now - journalCommitted < JOURNAL_COMMIT_INTERVAL)
+        return;
+    alert_journal_commit (journal);
+    journalCommitted = now;
+}
+
+static void
+s_log_stats () {
+    alertMtx.lock ();
+    size_t size = zlistx_size (alerts);
+    size_t lazy = lazyIndex.size ();
+    size_t damped = dampedAlerts;
+    alertMtx.unlock ();
+    log_info ("cache: %zu alerts, %zu RESOLVED left in the state file, %zu damped, %zu interned values",
+        size, lazy, damped, alert_intern_size ());
+    alert_stats_log ();
+}
+
+// Milliseconds until the stream actor has work due: damped alerts to
+// release, keep-alives and announcements to publish (paced per second), a
+// group commit of the journal or a checkpoint. Nothing due (an idle agent)
+// waits for the next message.
+// returns timeout for zpoller_wait (), -1 - none
+static int
+s_stream_timeout () {
+    int64_t now = zclock_mono ();
+    int64_t second = (now / 1000 + 1) * 1000;     // start of next second
+    int64_t next = INT64_MAX;
+
+    alertMtx.lock ();
+    if (dampedAlerts)
+        next = std::min (next, dampedNext * 1000);
+    // due keep-alive still queued waits for the rate limit
+    if (!keepalives.empty ())
+        next = std::min (next, keepalives.top ().first * 1000 <= now ? second : keepalives.top ().first * 1000);
+    if (!announcements.empty ())
+        next = std::min (next, second);
+    alertMtx.unlock ();
+
+    if (journal && alert_journal_pending (journal))
+        next = std::min (next, journalCommitted + JOURNAL_COMMIT_INTERVAL);
+    if (checkpointBusy)
+        next = std::min (next, now + CHECKPOINT_POLL_INTERVAL);
+    else
+    if (checkpointInterval && dirtyCount) {
+        int64_t interval = checkpointFailed ? std::max (checkpointInterval, (int64_t) 60) : checkpointInterval;
+        next = std::min (next, (checkpointLast + interval) * 1000);
+    }
+
+    if (next == INT64_MAX)
+        return -1;
+    return (int) std::min (std::max (next - now, (int64_t) 0), (int64_t) INT_MAX);
+}
+
+// handle messages already received by 'client' on shutdown, in order,
+// for STREAM_DRAIN_TIMEOUT ms at most
+// returns number of messages handled
+static size_t
+s_drain (mlm_client_t *client, const char *command, void (*handle) (mlm_client_t *, zmsg_t **)) {
+    int64_t end = zclock_mono () + STREAM_DRAIN_TIMEOUT;
+    size_t drained = 0;
+    while (zclock_mono () < end && (zsock_events (mlm_client_msgpipe (client)) & ZMQ_POLLIN)) {
+        zmsg_t *msg = mlm_client_recv (client);
+        if (!msg)
+            break;
+        if (streq (mlm_client_command (client), command)) {
+            handle (client, &msg);
+            drained++;
+        }
+        zmsg_destroy (&msg);
+    }
+    return drained;
+}
+
+// parse decimal 'string' within 'min' .. 'max' into 'number'
+// returns false for anything else, trailing characters included
+static bool
+s_parse_number (const char *string, int64_t min, int64_t max, int64_t *number) {
+    if (!string)
+        return false;
+    char *end = NULL;
+    errno = 0;
+    long long value = strtoll (string, &end, 10);
+    if (end == string || *end != '\0' || errno == ERANGE || value < min || value > max)
+        return false;
+    *number = (int64_t) value;
+    return true;
+}
+
 void
 fty_alert_list_server_stream (zsock_t *pipe, void *args) {
     const char *endpoint = (const char *) args;
     log_debug ("Stream endpoint = %s", endpoint);
 
-    zhash_t *expirations = zhash_new ();
     mlm_client_t *client = mlm_client_new ();
     mlm_client_connect (client, endpoint, 1000, "fty-alert-list-stream");
     mlm_client_set_consumer (client, "_ALERTS_SYS", ".*");
     mlm_client_set_producer (client, "ALERTS");
 
+    scanFrames = alert_frame_probe ();
+    srand ((unsigned) zclock_time ());
+
     zpoller_t *poller = zpoller_new (pipe, mlm_client_msgpipe (client), NULL);
+    zsock_t *wake = zsock_new_pull ("@" STREAM_WAKE_ENDPOINT);
+    if (wake)
+        zpoller_add (poller, wake);
+    else
+        log_warning ("cannot bind %s, acknowledges are committed with the next alert", STREAM_WAKE_ENDPOINT);
     zsock_signal (pipe, 0);
 
     while (!zsys_interrupted) {
 
-        void *which = zpoller_wait (poller, 1000);
+        void *which = zpoller_wait (poller, s_stream_timeout ());
+        s_release_damped_alerts (client);
+        s_publish_keepalives (client);
+        s_publish_announcements (client);
+        s_journal_tick (which == NULL);
+        s_checkpoint_tick ();
 
         if (which == pipe) {
             zmsg_t *msg = zmsg_recv (pipe);
@@ -574,18 +1446,111 @@ fty_alert_list_server_stream (zsock_t *pipe, void *args) {
                 break;
             }
             else if (streq (cmd, "TTLCLEANUP")) {
-                s_resolve_expired_alerts (expirations);
+                s_resolve_expired_alerts ();
+            }
+            else if (streq (cmd, "STATS")) {
+                s_log_stats ();
+            }
+            else if (streq (cmd, "FLAPPING")) {
+                // FLAPPING/window/transitions/hold-down, 0 transitions disables detection
+                char *window = zmsg_popstr (msg);
+                char *transitions = zmsg_popstr (msg);
+                char *holdDown = zmsg_popstr (msg);
+                int64_t windowValue, transitionsValue, holdDownValue;
+                if (s_parse_number (window, 1, INT_MAX, &windowValue)
+                &&  s_parse_number (transitions, 0, UINT32_MAX, &transitionsValue)
+                &&  s_parse_number (holdDown, 0, INT_MAX, &holdDownValue)) {
+                    flapWindow = windowValue;
+                    flapTransitions = (uint32_t) transitionsValue;
+                    flapHoldDown = holdDownValue;
+                    log_info ("flap detection: %" PRIu32 " state changes in %" PRIi64 " s, hold-down %" PRIi64 " s",
+                        flapTransitions, flapWindow, flapHoldDown);
+                }
+                else {
+                    log_error ("FLAPPING: bad arguments");
+                }
+                zstr_free (&window);
+                zstr_free (&transitions);
+                zstr_free (&holdDown);
+            }
+            else if (streq (cmd, "KEEPALIVE")) {
+                // KEEPALIVE/rate, keep-alive publishes per second at most
+                char *rate = zmsg_popstr (msg);
+                int64_t rateValue;
+                if (s_parse_number (rate, 1, INT_MAX, &rateValue)) {
+                    keepaliveRate = (size_t) rateValue;
+                    log_info ("keep-alive: %zu publishes per second at most", keepaliveRate);
+                }
+                else {
+                    log_error ("KEEPALIVE: bad arguments");
+                }
+                zstr_free (&rate);
+            }
+            else if (streq (cmd, "CHECKPOINT")) {
+                // CHECKPOINT/interval/dirty[/journal[/chunk]], 0 disables the trigger
+                char *interval = zmsg_popstr (msg);
+                char *dirty = zmsg_popstr (msg);
+                char *limit = zmsg_popstr (msg);
+                char *chunk = zmsg_popstr (msg);
+                int64_t intervalValue, dirtyValue, limitValue = (int64_t) journalLimit, chunkValue = (int64_t) checkpointChunk;
+                if (s_parse_number (interval, 0, INT_MAX, &intervalValue)
+                &&  s_parse_number (dirty, 0, INT64_MAX, &dirtyValue)
+                &&  (!limit || s_parse_number (limit, 0, INT64_MAX, &limitValue))
+                &&  (!chunk || s_parse_number (chunk, 1, INT_MAX, &chunkValue))) {
+                    checkpointInterval = intervalValue;
+                    checkpointDirty = (size_t) dirtyValue;
+                    journalLimit = (size_t) limitValue;
+                    checkpointChunk = (size_t) chunkValue;
+                    log_info ("checkpoint: every %" PRIi64 " s, %zu changes or %zu journal bytes, %zu alerts per lock",
+                        checkpointInterval, checkpointDirty, journalLimit, checkpointChunk.load ());
+                }
+                else {
+                    log_error ("CHECKPOINT: bad arguments");
+                }
+                zstr_free (&interval);
+                zstr_free (&dirty);
+                zstr_free (&limit);
+                zstr_free (&chunk);
+            }
+            else if (streq (cmd, "STATEFORMAT")) {
+                // STATEFORMAT/zpl|image, format of the state file written by checkpoints
+                char *format = zmsg_popstr (msg);
+                if (format && (streq (format, "zpl") || streq (format, "image"))) {
+                    stateImage = streq (format, "image");
+                    log_info ("state file format: %s", format);
+                }
+                else {
+                    log_error ("STATEFORMAT: bad arguments");
+                }
+                zstr_free (&format);
+            }
+            else if (streq (cmd, "ANNOUNCE")) {
+                // ANNOUNCE/rate, republish all alerts not RESOLVED, rate per second
+                char *rate = zmsg_popstr (msg);
+                int64_t rateValue;
+                if (s_parse_number (rate, 1, INT_MAX, &rateValue))
+                    s_announce_alerts ((size_t) rateValue);
+                else
+                    log_error ("ANNOUNCE: bad arguments");
+                zstr_free (&rate);
             }
             zstr_free (&cmd);
             zmsg_destroy (&msg);
         }
+        else if (wake && which == wake) {
+            // the cache was changed by the mailbox actor, the ticks above
+            // and the next timeout take care of it
+            zmsg_t *msg = zmsg_recv (wake);
+            zmsg_destroy (&msg);
+        }
         else if (which == mlm_client_msgpipe (client)) {
             zmsg_t *msg = mlm_client_recv (client);
             if (!msg) {
                 break;
             }
             else if (streq (mlm_client_command (client), "STREAM DELIVER")) {
-                s_handle_stream_deliver (client, &msg, expirations);
+                s_handle_stream_deliver (client, &msg);
+                zmsg_destroy (&msg);
             }
             else {
                 log_warning ("Unknown command '%s'. Subject: '%s', Sender: '%s'.",
@@ -595,9 +1560,17 @@ fty_alert_list_server_stream (zsock_t *pipe, void *args) {
         }
     }
 
+    // alerts received before the shutdown are not lost
+    size_t drained = s_drain (client, "STREAM DELIVER", s_handle_stream_deliver);
+    if (drained)
+        log_info ("%zu alerts handled on shutdown", drained);
+
+    s_checkpoint_join ();
+    if (journal)
+        alert_journal_commit (journal);
     mlm_client_destroy (&client);
     zpoller_destroy (&poller);
-    zhash_destroy (&expirations);
+    zsock_destroy (&wake);
 }
 
 void
@@ -608,13 +1581,18 @@ fty_alert_list_server_mailbox (zsock_t *pipe, void *args) {
     mlm_client_t *client = mlm_client_new ();
     mlm_client_connect (client, endpoint, 1000, "fty-alert-list");
     mlm_client_set_producer (client, "ALERTS");
+    mailboxPipe = pipe;
+    streamWake = zsock_new_push (">" STREAM_WAKE_ENDPOINT);
+    if (streamWake)
+        zsock_set_sndtimeo (streamWake, 0);
 
     zpoller_t *poller = zpoller_new (pipe, mlm_client_msgpipe (client), NULL);
     zsock_signal (pipe, 0);
 
     while (!zsys_interrupted) {
 
-        void *which = zpoller_wait (poller, 1000);
+        // nothing to do but answer requests
+        void *which = zpoller_wait (poller, -1);
         if (which == pipe) {
             zmsg_t *msg = zmsg_recv (pipe);
             char *cmd = zmsg_popstr (msg);
@@ -642,30 +1620,118 @@ fty_alert_list_server_mailbox (zsock_t *pipe, void *args) {
         }
     }
 
+    // requests received before the shutdown are answered
+    size_t drained = s_drain (client, "MAILBOX DELIVER", s_handle_mailbox_deliver);
+    if (drained)
+        log_info ("%zu requests handled on shutdown", drained);
+
+    mailboxPipe = NULL;
+    zsock_destroy (&streamWake);
     mlm_client_destroy (&client);
     zpoller_destroy (&poller);
 }
 
+// final checkpoint, in the calling thread
 void save_alerts () {
-    int rv = alert_save_state (alerts, STATE_PATH, STATE_FILE, verbose);
-    log_debug ("alert_save_state () == %d", rv);
+    s_checkpoint_join ();
+    if (journal)
+        alert_journal_commit (journal);
+    s_checkpoint (dirtyCount.exchange (0));
 }
 
-void
-init_alert (bool verb) {
+// Load the cache from state file 'filename' in 'path'. Only alerts not
+// RESOLVED are decoded from a state image, RESOLVED ones are indexed in
+// lazyIndex by identity and decoded when an incoming alert or a request
+// touches them, so that startup time follows the number of alerts that
+// matter. Other state files are loaded whole.
+static void
+s_cache_load (const char *path, const char *filename) {
     alerts = zlistx_new ();
     assert(alerts);
     zlistx_set_destructor (alerts, (czmq_destructor *) fty_proto_destroy);
     zlistx_set_duplicator (alerts, (czmq_duplicator *) fty_proto_dup);
 
-    int rv = alert_load_state (alerts, STATE_PATH, STATE_FILE);
-    log_debug ("alert_load_state () == %d", rv);
+    lazyImage = alert_image_open (path, filename);
+    if (lazyImage) {
+        std::unordered_set<const char *> identities;
+        identities.reserve (alert_image_count (lazyImage));
+        for (size_t index = 0; index < alert_image_count (lazyImage); index++) {
+            const alert_image_record_t *record = alert_image_record (lazyImage, index);
+            const char *identity = alert_intern_identity (
+                alert_image_str (lazyImage, record->rule), alert_image_str (lazyImage, record->name));
+            // first record of an alert wins, as with alert_load_state ()
+            if (identity && !identities.insert (identity).second)
+                continue;
+            if (identity && record->state == ALERT_STATE_RESOLVED) {
+                lazyIndex [identity] = index;
+                continue;
+            }
+            fty_proto_t *alert = alert_image_decode (lazyImage, index);
+            if (alert) {
+                zlistx_add_end (alerts, alert);
+                fty_proto_destroy (&alert);
+            }
+        }
+
+        // changes made since the state file was saved, the journal wins
+        int replayed = alert_journal_replay (alerts, path, filename);
+        if (replayed > 0)
+            log_info ("%d changes replayed from the journal", replayed);
+        for (fty_proto_t *cursor = (fty_proto_t *) zlistx_first (alerts); cursor;
+                cursor = (fty_proto_t *) zlistx_next (alerts))
+            lazyIndex.erase (alert_intern_identity (fty_proto_rule (cursor), fty_proto_name (cursor)));
+
+        log_info ("%zu alerts loaded from %s/%s, %zu RESOLVED left there",
+            zlistx_size (alerts), path, filename, lazyIndex.size ());
+        if (lazyIndex.empty ())
+            alert_image_destroy (&lazyImage);
+    }
+    else {
+        int rv = alert_load_state (alerts, path, filename);
+        log_debug ("alert_load_state () == %d", rv);
+    }
+
+    int64_t mono = zclock_mono () / 1000;
+    int64_t wall = (int64_t) time (NULL);
+    fty_proto_t *cursor = (fty_proto_t *) zlistx_first (alerts);
+    while (cursor) {
+        alert_info_t &info = s_alert_track (cursor, alert_intern_identity (fty_proto_rule (cursor), fty_proto_name (cursor)));
+        s_alert_import_times (cursor, info, mono, wall);
+        cursor = (fty_proto_t *) zlistx_next (alerts);
+    }
+}
+
+void
+set_state_file (const char *path, const char *filename) {
+    assert (path && filename);
+    statePath = path;
+    stateFile = filename;
+}
+
+void
+init_alert (bool verb) {
+    s_cache_load (statePath.c_str (), stateFile.c_str ());
+
+    journal = alert_journal_new (statePath.c_str (), stateFile.c_str ());
+    if (!journal)
+        log_warning ("changes of alerts are not journaled");
 
     verbose = verb;
 }
 
 void
 destroy_alert () {
+    announcements.clear ();
+    keepalives = decltype (keepalives) ();
+    dampedAlerts = 0;
+    dampedNext = 0;
+    s_checkpoint_join ();
+    alert_journal_destroy (&journal);
+    alertsOrder.clear ();
+    alertsIndex.clear ();
+    alertsInfo.clear ();
+    lazyIndex.clear ();
+    alert_image_destroy (&lazyImage);
     zlistx_destroy (&alerts);
 }
 
@@ -984,6 +2050,147 @@ fty_alert_list_server_test (bool verb) {
 
     printf (" * fty_alerts_list_server: ");
 
+    // transition table
+    {
+        for (int stored = ALERT_STATE_UNKNOWN; stored <= ALERT_STATE_ALL_ACTIVE; stored++) {
+            for (int changed = 0; changed < 2; changed++) {
+                const transition_t &active = s_transition ((alert_state_t) stored, ALERT_STATE_ACTIVE, changed);
+                const transition_t &resolved = s_transition ((alert_state_t) stored, ALERT_STATE_RESOLVED, changed);
+
+                // description and lifetime come with ACTIVE alerts only
+                assert (active.take_description);
+                assert (!resolved.take_description);
+                // time changes only with state, or while ACTIVE
+                assert (active.take_time == (active.take_state || stored == ALERT_STATE_ACTIVE));
+                assert (resolved.take_time == resolved.take_state);
+
+                if (stored == ALERT_STATE_RESOLVED) {
+                    assert (active.publish == PUBLISH_ALWAYS && active.take_state && active.reset_ctime);
+                    assert (resolved.publish == PUBLISH_NEVER && !resolved.take_state && !resolved.reset_ctime);
+                }
+                else {
+                    assert (resolved.publish == PUBLISH_ALWAYS && resolved.take_state && resolved.reset_ctime);
+                    assert (!active.take_state);
+                    if (stored == ALERT_STATE_ACTIVE) {
+                        assert (active.publish == (changed ? PUBLISH_ALWAYS : PUBLISH_IF_DUE));
+                        assert (active.reset_ctime == (bool) changed);
+                    }
+                    else {
+                        // acknowledged (or unknown) alert is published only on severity change
+                        assert (active.publish == (changed ? PUBLISH_ALWAYS : PUBLISH_NEVER));
+                        assert (!active.reset_ctime);
+                    }
+                }
+            }
+        }
+    }
+
+    // TTL deadline and last publish survive a restart
+    {
+        zlist_t *actions = zlist_new ();
+        zlist_autofree (actions);
+        fty_proto_t *alert = alert_new ("Rule", "Element", "ACTIVE", "CRITICAL", "description", 1, &actions, 600);
+        assert (alert);
+        fty_proto_set_ttl (alert, 600);
+        alert_info_t info = alert_info_t ();
+        info.state = ALERT_STATE_ACTIVE;
+        info.expires = 1000 + 300;
+        info.last_sent = 1000 - 60;
+        s_alert_export_times (alert, info, 1000, 1600000000);
+        assert (fty_proto_aux_number (alert, STATE_AUX_DEADLINE, 0) == 1600000300);
+        assert (fty_proto_aux_number (alert, STATE_AUX_LAST_SENT, 0) == 1599999940);
+
+        // restarted 100 s later, with another monotonic clock
+        alert_info_t restored = alert_info_t ();
+        restored.state = ALERT_STATE_ACTIVE;
+        s_alert_import_times (alert, restored, 50, 1600000100);
+        assert (restored.expires == 50 + 200);
+        assert (restored.last_sent == 50 - 160);
+        assert (restored.keepalive_due != 0);
+        assert (fty_proto_aux_string (alert, STATE_AUX_DEADLINE, NULL) == NULL);
+
+        // deadline passed while down, expires at once
+        s_alert_export_times (alert, info, 1000, 1600000000);
+        restored = alert_info_t ();
+        restored.state = ALERT_STATE_ACTIVE;
+        s_alert_import_times (alert, restored, 50, 1600001000);
+        assert (restored.expires > 0 && restored.expires < 50);
+
+        // no deadline saved, full ttl
+        restored = alert_info_t ();
+        restored.state = ALERT_STATE_ACTIVE;
+        s_alert_import_times (alert, restored, 50, 1600001000);
+        assert (restored.expires >= zclock_mono () / 1000 + 600 - 1);
+
+        keepalives = decltype (keepalives) ();
+        fty_proto_destroy (&alert);
+    }
+
+    // RESOLVED alerts of the state image are decoded when touched
+    {
+        zlistx_t *saved = zlistx_new ();
+        zlistx_set_destructor (saved, (czmq_destructor *) fty_proto_destroy);
+        for (int i = 0; i < 4; i++) {
+            zlist_t *actions = zlist_new ();
+            zlist_autofree (actions);
+            char element [32];
+            snprintf (element, sizeof (element), "Element%d", i);
+            zlistx_add_end (saved, alert_new ("Rule", element, i < 3 ? "RESOLVED" : "ACTIVE", "CRITICAL", "description", i, &actions, 0));
+        }
+        assert (alert_save_state (saved, ".", "test_state_lazy", false) == 0);
+        // change journaled after the save
+        alert_journal_t *changes = alert_journal_new (".", "test_state_lazy");
+        assert (changes);
+        fty_proto_t *changed = (fty_proto_t *) zlistx_first (saved);
+        fty_proto_set_state (changed, "%s", "ACTIVE");
+        assert (alert_journal_append (changes, changed) == 0);
+        alert_journal_destroy (&changes);
+
+        s_cache_load (".", "test_state_lazy");
+        assert (zlistx_size (alerts) == 2);
+        assert (lazyIndex.size () == 2);
+        assert (lazyImage);
+        const char *identity = alert_intern_identity ("Rule", "Element0");
+        assert (alertsIndex.count (identity) && !lazyIndex.count (identity));
+
+        identity = alert_intern_identity ("Rule", "Element2");
+        fty_proto_t *cursor = s_alert_materialize (identity);
+        assert (cursor);
+        assert (streq (fty_proto_name (cursor), "Element2"));
+        assert (alertsIndex [identity] == cursor);
+        assert (s_alert_info (cursor)->state == ALERT_STATE_RESOLVED);
+        assert (lazyIndex.size () == 1);
+        assert (s_alert_materialize (identity) == NULL);
+
+        // untracked alert has no record, none is made up
+        size_t tracked = alertsInfo.size ();
+        fty_proto_t *stranger = fty_proto_new (FTY_PROTO_ALERT);
+        assert (s_alert_info (stranger) == NULL);
+        assert (alertsInfo.size () == tracked);
+        fty_proto_destroy (&stranger);
+
+        // checkpoint copies the rest from the state image
+        std::vector<size_t> records = s_lazy_records ();
+        assert (records.size () == 1);
+        zchunk_t *image = alert_image_encode_records (alerts, lazyImage, records.data (), records.size ());
+        assert (image);
+        assert (alert_image_write (image, ".", "test_state_lazy_checkpoint") == 0);
+        zchunk_destroy (&image);
+        zlistx_t *loaded = zlistx_new ();
+        zlistx_set_destructor (loaded, (czmq_destructor *) fty_proto_destroy);
+        assert (alert_load_state (loaded, ".", "test_state_lazy_checkpoint") == 0);
+        assert (zlistx_size (loaded) == 4);
+        zlistx_destroy (&loaded);
+
+        destroy_alert ();
+        assert (lazyIndex.empty () && !lazyImage);
+        zlistx_destroy (&saved);
+        const char *files [] = { "test_state_lazy", "test_state_lazy.prev", "test_state_lazy" JOURNAL_SUFFIX,
+            "test_state_lazy_checkpoint", "test_state_lazy_checkpoint.prev" };
+        for (const char *file : files)
+            zsys_file_delete (file);
+    }
+
     // Malamute
     zactor_t *server = zactor_new (mlm_server, (void *) "Malamute");
     zstr_sendx (server, "BIND", endpoint, NULL);
@@ -1010,6 +2217,15 @@ fty_alert_list_server_test (bool verb) {
     assert (rv == 0);
 
     // Alert Lists
+    int64_t statsReceived = alert_stats_get (ALERT_STATS_RECEIVED);
+    int64_t statsPublished = alert_stats_get (ALERT_STATS_PUBLISHED);
+    int64_t statsList = alert_stats_get (ALERT_STATS_LIST_REQUESTS);
+    int64_t statsAck = alert_stats_get (ALERT_STATS_ACK_REQUESTS);
+    const char *stateFiles [] = { "test_state_server", "test_state_server.prev",
+        "test_state_server" JOURNAL_SUFFIX, "test_state_server" JOURNAL_ROTATED_SUFFIX };
+    for (const char *file : stateFiles)
+        zsys_file_delete (file);
+    set_state_file (".", "test_state_server");
     init_alert (verb);
     zactor_t *fty_al_server_stream = zactor_new (fty_alert_list_server_stream, (void *) endpoint);
     zactor_t *fty_al_server_mailbox = zactor_new (fty_alert_list_server_mailbox, (void *) endpoint);
@@ -1070,6 +2286,16 @@ fty_alert_list_server_test (bool verb) {
     reply = test_request_alerts_list (ui, "ALL");
     test_check_result ("ALL", testAlerts, &reply, 0);
 
+    // same alert, different action set
+    zlist_t *actions13 = zlist_new ();
+    zlist_autofree (actions13);
+    zlist_append (actions13, (void *) "SMS");
+    alert = alert_new ("Threshold", "epdu", "ACTIVE", "high", "description", 2, &actions13, 0);
+    test_alert_publish (producer, consumer, testAlerts, &alert);
+
+    reply = test_request_alerts_list (ui, "ALL");
+    test_check_result ("ALL", testAlerts, &reply, 0);
+
     reply = test_request_alerts_list (ui, "ACTIVE");
     test_check_result ("ACTIVE", testAlerts, &reply, 0);
 
@@ -1194,6 +2420,19 @@ fty_alert_list_server_test (bool verb) {
     test_request_alerts_acknowledge (ui, consumer, "Threshold", "ŽlUťOUčKý kůň супер", "ACK-SILENCE", testAlerts, 1);
     test_request_alerts_acknowledge (ui, consumer, "Threshold", "ŽlUťOUčKý kůň супер", "ACK-PAUSE", testAlerts, 1);
 
+    // acknowledge is committed to the journal without any stream traffic
+    {
+        assert (journal);
+        const char *states [] = { "ACK-WIP", "ACK-PAUSE" };
+        for (const char *state : states) {
+            test_request_alerts_acknowledge (ui, consumer, "Threshold", "epdu", state, testAlerts, 0);
+            int64_t end = zclock_mono () + 1000;
+            while (alert_journal_pending (journal) && zclock_mono () < end)
+                zclock_sleep (10);
+            assert (alert_journal_pending (journal) == 0);
+        }
+    }
+
     reply = test_request_alerts_list (ui, "ALL");
     test_check_result ("ALL", testAlerts, &reply, 0);
 
@@ -1558,6 +2797,210 @@ fty_alert_list_server_test (bool verb) {
     zstr_free (&part);
     zmsg_destroy (&reply);
 
+    // configuration reload is passed to the owner of the mailbox actor
+    send = zmsg_new ();
+    zmsg_addstr (send, "RELOAD");
+    rv = mlm_client_sendto (ui, "fty-alert-list", RFC_ALERTS_CONFIG_SUBJECT, NULL, 5000, &send);
+    assert (rv == 0);
+    reply = mlm_client_recv (ui);
+    part = zmsg_popstr (reply);
+    assert (streq (part, "OK"));
+    zstr_free (&part);
+    zmsg_destroy (&reply);
+    part = zstr_recv (fty_al_server_mailbox);
+    assert (streq (part, "RELOAD"));
+    zstr_free (&part);
+
+    send = zmsg_new ();
+    zmsg_addstr (send, "RESTART");
+    rv = mlm_client_sendto (ui, "fty-alert-list", RFC_ALERTS_CONFIG_SUBJECT, NULL, 5000, &send);
+    assert (rv == 0);
+    reply = mlm_client_recv (ui);
+    part = zmsg_popstr (reply);
+    assert (streq (part, "ERROR"));
+    zstr_free (&part);
+    part = zmsg_popstr (reply);
+    assert (streq (part, "BAD_COMMAND"));
+    zstr_free (&part);
+    zmsg_destroy (&reply);
+
+    // RESOLVED alert received again is handled without decoding it
+    {
+        zlist_t *actions = zlist_new ();
+        zlist_autofree (actions);
+        zlist_append (actions, (void *) "EMAIL");
+        alert = alert_new ("Scanned", "rack", "RESOLVED", "high", "description", 20, &actions, 0);
+        fty_proto_t *again = fty_proto_dup (alert);
+        test_alert_publish (producer, consumer, testAlerts, &alert);
+
+        int64_t skipped = alert_stats_get (ALERT_STATS_DECODE_SKIPPED);
+        zmsg_t *encoded = fty_proto_encode (&again);
+        rv = mlm_client_send (producer, "Nobody here cares about this.", &encoded);
+        assert (rv == 0);
+        zclock_sleep (100);
+        assert (alert_stats_get (ALERT_STATS_DECODE_SKIPPED) == skipped + 1);
+
+        reply = test_request_alerts_list (ui, "RESOLVED");
+        test_check_result ("RESOLVED", testAlerts, &reply, 0);
+    }
+
+    // same-severity ACTIVE re-evaluation is a refresh (still published, ttl is 0)
+    {
+        zlist_t *actions = zlist_new ();
+        zlist_autofree (actions);
+        alert = alert_new ("Refreshed", "rack", "ACTIVE", "high", "description", 21, &actions, 0);
+        fty_proto_t *again = fty_proto_dup (alert);
+        test_alert_publish (producer, consumer, testAlerts, &alert);
+
+        int64_t refreshed = alert_stats_get (ALERT_STATS_REFRESHED);
+        test_alert_publish (producer, consumer, testAlerts, &again);
+        assert (alert_stats_get (ALERT_STATS_REFRESHED) == refreshed + 1);
+
+        reply = test_request_alerts_list (ui, "ACTIVE");
+        test_check_result ("ACTIVE", testAlerts, &reply, 0);
+    }
+
+    // flapping alert is damped, only its settled state is published
+    {
+        zstr_sendx (fty_al_server_stream, "FLAPPING", "3600", "3", "1", NULL);
+        int64_t flapping = alert_stats_get (ALERT_STATS_FLAPPING);
+        int64_t damped = alert_stats_get (ALERT_STATS_DAMPED);
+        const char *states [] = { "ACTIVE", "RESOLVED", "ACTIVE", "RESOLVED", "ACTIVE", "RESOLVED" };
+        for (int i = 0; i < 6; i++) {
+            zlist_t *actions = zlist_new ();
+            zlist_autofree (actions);
+            zmsg_t *encoded = fty_proto_encode_alert (NULL, 30 + i, 0, "Flapping", "rack", states [i], "high", "description", actions);
+            zlist_destroy (&actions);
+            rv = mlm_client_send (producer, "Nobody cares", &encoded);
+            assert (rv == 0);
+            zclock_sleep (100);
+            // third state change starts the damping
+            if (i < 3) {
+                encoded = mlm_client_recv (consumer);
+                assert (encoded);
+                zmsg_destroy (&encoded);
+            }
+        }
+        assert (alert_stats_get (ALERT_STATS_FLAPPING) == flapping + 1);
+        assert (alert_stats_get (ALERT_STATS_DAMPED) == damped + 3);
+
+        zclock_sleep (2500);
+        zmsg_t *encoded = mlm_client_recv (consumer);
+        assert (encoded);
+        fty_proto_t *settled = fty_proto_decode (&encoded);
+        assert (settled);
+        assert (streq (fty_proto_rule (settled), "Flapping"));
+        assert (streq (fty_proto_state (settled), "RESOLVED"));
+        assert (fty_proto_time (settled) == 35);
+        fty_proto_destroy (&settled);
+        zstr_sendx (fty_al_server_stream, "FLAPPING", "3600", "0", "1", NULL);
+    }
+
+    // refreshed ACTIVE alert is kept alive by the scheduler, not by the refresh
+    {
+        int64_t keepalives = alert_stats_get (ALERT_STATS_KEEPALIVES);
+        for (int i = 0; i < 2; i++) {
+            zlist_t *actions = zlist_new ();
+            zlist_autofree (actions);
+            zmsg_t *encoded = fty_proto_encode_alert (NULL, 40 + i, 4, "Keepalive", "rack", "ACTIVE", "high", "description", actions);
+            zlist_destroy (&actions);
+            rv = mlm_client_send (producer, "Nobody cares", &encoded);
+            assert (rv == 0);
+            zclock_sleep (100);
+        }
+        // new alert is published, the refresh is not (keep-alive due in 1 - 2 s)
+        zmsg_t *encoded = mlm_client_recv (consumer);
+        assert (encoded);
+        zmsg_destroy (&encoded);
+        assert (alert_stats_get (ALERT_STATS_KEEPALIVES) == keepalives);
+
+        zclock_sleep (3000);
+        assert (alert_stats_get (ALERT_STATS_KEEPALIVES) == keepalives + 1);
+        encoded = mlm_client_recv (consumer);
+        assert (encoded);
+        fty_proto_t *kept = fty_proto_decode (&encoded);
+        assert (kept);
+        assert (streq (fty_proto_rule (kept), "Keepalive"));
+        assert (fty_proto_time (kept) == 41);
+        fty_proto_destroy (&kept);
+    }
+
+    // all alerts not RESOLVED are re-announced, paced
+    {
+        int64_t announced = alert_stats_get (ALERT_STATS_ANNOUNCED);
+        zstr_sendx (fty_al_server_stream, "ANNOUNCE", "2", NULL);
+        zpoller_t *poller = zpoller_new (mlm_client_msgpipe (consumer), NULL);
+        size_t received = 0;
+        while (zpoller_wait (poller, 1500)) {
+            zmsg_t *encoded = mlm_client_recv (consumer);
+            assert (encoded);
+            fty_proto_t *decoded = fty_proto_decode (&encoded);
+            assert (decoded);
+            assert (!streq (fty_proto_state (decoded), "RESOLVED"));
+            fty_proto_destroy (&decoded);
+            received++;
+        }
+        zpoller_destroy (&poller);
+        assert (received > 2);
+        assert (alert_stats_get (ALERT_STATS_ANNOUNCED) == announced + (int64_t) received);
+    }
+
+    // changed cache is checkpointed in the background
+    {
+        int64_t checkpoints = alert_stats_get (ALERT_STATS_CHECKPOINTS);
+        zstr_sendx (fty_al_server_stream, "CHECKPOINT", "3600", "1", NULL);
+        zclock_sleep (2500);
+        assert (alert_stats_get (ALERT_STATS_CHECKPOINTS) == checkpoints + 1);
+        zstr_sendx (fty_al_server_stream, "CHECKPOINT", "0", "0", NULL);
+    }
+
+    // mistyped settings are refused, the previous ones are kept
+    {
+        size_t limit = journalLimit;
+        size_t rate = keepaliveRate;
+        int64_t window = flapWindow;
+        zstr_sendx (fty_al_server_stream, "CHECKPOINT", "5m", "1", "4M", NULL);
+        zstr_sendx (fty_al_server_stream, "KEEPALIVE", "abc", NULL);
+        zstr_sendx (fty_al_server_stream, "FLAPPING", "300", "2", "2m", NULL);
+        zclock_sleep (100);
+        assert (checkpointInterval == 0 && checkpointDirty == 0 && journalLimit == limit);
+        assert (keepaliveRate == rate);
+        assert (flapWindow == window);
+    }
+
+    // state file format of checkpoints, ZPL by default
+    {
+        assert (!stateImage);
+        zstr_sendx (fty_al_server_stream, "STATEFORMAT", "image", NULL);
+        zstr_sendx (fty_al_server_stream, "STATEFORMAT", "yaml", NULL);
+        zclock_sleep (100);
+        assert (stateImage);
+        save_alerts ();
+        alert_image_t *image = alert_image_open (".", "test_state_server");
+        assert (image);
+        alert_image_destroy (&image);
+
+        zstr_sendx (fty_al_server_stream, "STATEFORMAT", "zpl", NULL);
+        zclock_sleep (100);
+        assert (!stateImage);
+        save_alerts ();
+        assert (alert_image_open (".", "test_state_server") == NULL);
+        zlistx_t *loaded = zlistx_new ();
+        zlistx_set_destructor (loaded, (czmq_destructor *) fty_proto_destroy);
+        assert (alert_load_state (loaded, ".", "test_state_server") == 0);
+        assert (zlistx_size (loaded) > 0);
+        zlistx_destroy (&loaded);
+    }
+
+    // counters
+    assert (alert_stats_get (ALERT_STATS_RECEIVED) > statsReceived);
+    assert (alert_stats_get (ALERT_STATS_PUBLISHED) > statsPublished);
+    assert (alert_stats_get (ALERT_STATS_PUBLISHED) - statsPublished <= alert_stats_get (ALERT_STATS_RECEIVED) - statsReceived);
+    assert (alert_stats_get (ALERT_STATS_LIST_REQUESTS) > statsList);
+    assert (alert_stats_get (ALERT_STATS_ACK_REQUESTS) > statsAck);
+    assert (alert_stats_get (ALERT_STATS_POOL_ALLOCS) > 0);
+    zstr_send (fty_al_server_stream, "STATS");
+
     zlistx_destroy (&testAlerts);
 
     save_alerts ();
@@ -1568,6 +3011,8 @@ fty_alert_list_server_test (bool verb) {
     mlm_client_destroy (&ui);
     zactor_destroy (&server);
     destroy_alert ();
+    for (const char *file : stateFiles)
+        zsys_file_delete (file);
 
     if (NULL != actions1)
         zlist_destroy (&actions1);
@@ -1593,6 +3038,8 @@ fty_alert_list_server_test (bool verb) {
         zlist_destroy (&actions11);
     if (NULL != actions12)
         zlist_destroy (&actions12);
+    if (NULL != actions13)
+        zlist_destroy (&actions13);
 
     printf ("OK\n");
 }